@@ -4,7 +4,11 @@
 			"target_name": "desktopduplication",
 			"sources": [
 				"src/getframeasyncworker.cpp",
-				"src/desktopduplication.cpp"
+				"src/desktopduplication.cpp",
+				"src/pixelconvert.cpp",
+				"src/capturegovernor.cpp",
+				"src/devicecache.cpp",
+				"src/initializeasyncworker.cpp"
 			],
 			"include_dirs": [
 				"<!@(node -p \"require('node-addon-api').include\")"
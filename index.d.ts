@@ -1,13 +1,89 @@
 import { EventEmitter } from 'events';
 
+/** Pixel formats a frame can be delivered in. */
+export declare type PixelFormat = "rgba8" | "bgra8" | "rgb10a2" | "rgba16f" | "nv12" | "i420";
+
+/** Color encoding of the captured surface. */
+export declare type ColorSpace = "srgb" | "scrgb" | "pq";
+
+/** Position of one plane of the image inside `data`. */
+export declare interface FramePlane {
+    /** Byte offset of the first row of the plane. */
+    offset: number,
+    /** Bytes between the start of two rows. */
+    stride: number,
+    /** Number of rows in the plane. */
+    height: number
+}
+
 /** Represents the image captured from screen. */
 export declare interface Frame {
-    /** Buffer with the raw pixel values in RGBA order. */
+    /** Buffer with the raw pixel values in the layout given by `format`. */
     data: Buffer,
     /** Width of the captured frame. */
     width: number,
     /** Height of the captured frame. */
-    height: number
+    height: number,
+    /** Pixel format of `data`. This is always `"rgba8"` unless a different output format was requested. */
+    format: PixelFormat,
+    /** Pixel format of the surface the frame was captured from. */
+    sourceFormat: Exclude<PixelFormat, "rgba8" | "nv12" | "i420">,
+    /** Color encoding of the surface the frame was captured from. */
+    sourceColorSpace: ColorSpace,
+    /** Clockwise rotation in degrees which was applied to get from the scan-out orientation of the monitor to the desktop orientation. */
+    rotation: 0 | 90 | 180 | 270,
+    /** Layout of the planes in `data`, a single plane for the packed formats, Y and UV for `"nv12"` and Y, U and V for `"i420"`. */
+    planes: FramePlane[]
+}
+
+/** Options for the adaptive capture rate. */
+export declare interface AdaptiveCaptureOptions {
+    /** Lowest capture rate, used while the desktop is idle or the **frame** listeners are not keeping up (default: `1`). */
+    minFps?: number,
+    /** Highest capture rate, used while the desktop is changing (default: `30`). */
+    maxFps?: number,
+    /** Fraction of a single CPU core that may be spent on copying and converting frames (default: `0.25`). */
+    cpuBudget?: number
+}
+
+/** Current decision of the adaptive capture rate. */
+export declare interface AdaptiveCaptureState {
+    /** Time between two capture attempts in milliseconds. */
+    interval: number,
+    /** The reason for the last change of the interval. */
+    reason: "startup" | "changing" | "idle" | "consumerlag" | "cpubudget",
+    /** Moving average of the fraction of capture attempts that returned a new frame. */
+    changeRate: number,
+    /** Moving average of the time spent on copying and converting a frame in milliseconds. */
+    processingTime: number,
+    /** Moving average of the rate at which frames are delivered. */
+    fps: number,
+    /** Number of frames that were captured, but not passed to JS yet. */
+    pendingFrames: number,
+    /** Number of frames that were thrown away because the **frame** listeners did not keep up (only with `allowSkips`). */
+    droppedFrames: number
+}
+
+/** Options for the capture of a single screen. */
+export declare interface DesktopDuplicationOptions {
+    /** Capture HDR screens in their native 10 or 16 bit format instead of letting Windows convert them to 8 bit (default: `false`). */
+    hdr?: boolean,
+    /** Rotate frames from rotated (e.g. portrait) monitors into desktop orientation (default: `true`). */
+    rotate?: boolean,
+    /**
+     * `"rgba8"` (default) converts every surface to 8 bit RGBA, tone mapping HDR content down to SDR.  
+     * `"native"` returns the pixel values exactly as they are stored in the captured surface.  
+     * `"nv12"` and `"i420"` convert to 4:2:0 YUV for video encoders.
+     */
+    outputFormat?: "rgba8" | "native" | "nv12" | "i420",
+    /** Color matrix of the YUV output formats (default: `"bt709"`). */
+    yuvMatrix?: "bt601" | "bt709",
+    /** Value range of the YUV output formats, `"limited"` is 16-235 for Y and 16-240 for UV (default: `"limited"`). */
+    yuvRange?: "limited" | "full",
+    /** Brightness of SDR white on HDR screens in nits, which is mapped to full white in the RGBA output (default: `80`). */
+    sdrWhiteLevel?: number,
+    /** Brightness in nits at which highlights above SDR white are blended all the way to full white, brighter values are clipped (default: `1000`). */
+    maxLuminance?: number
 }
 
 /** A native addon to use the Windows Desktop Duplication API. */
@@ -19,7 +95,7 @@ export declare class DesktopDuplication extends EventEmitter {
      * Creates a new instance for the screen `screenNum`.  
      * Use the `getMonitorCount()` method to get the number of available screens.
      */
-    constructor(screenNum: number);
+    constructor(screenNum: number, options?: DesktopDuplicationOptions);
 
     /**
      * Setup the required DirectX objects.  
@@ -27,6 +103,12 @@ export declare class DesktopDuplication extends EventEmitter {
      */
     initialize(): void;
 
+    /**
+     * Like `initialize`, but the DirectX objects are set up in a separate thread.  
+     * The returned promise rejects if the initialization fails.
+     */
+    initializeAsync(): Promise<void>;
+
     /**
      * Synchronously gets a single frame in the default format.  
      * If the procedure fails, retry up to `retryCount` times (default: 5).  
@@ -50,6 +132,17 @@ export declare class DesktopDuplication extends EventEmitter {
      */
     startAutoCapture(delay: number, allowSkips?: boolean): void;
 
+    /**
+     * Like `startAutoCapture`, but instead of using a fixed delay the capture rate adapts between `minFps` and `maxFps`.  
+     * The rate is raised while the desktop is changing and lowered while it is idle or while the **frame** listeners are not keeping up.
+     * The time spent on converting frames is additionally limited to `cpuBudget`.
+     * Unlike with `startAutoCapture`, no **frame** events are emitted while the desktop does not change.
+     */
+    startAdaptiveCapture(options?: AdaptiveCaptureOptions, allowSkips?: boolean): void;
+
+    /** Returns the current decision of the adaptive capture rate, or `null` if `startAdaptiveCapture` has not been called. */
+    getAdaptiveCaptureState(): AdaptiveCaptureState | null;
+
     /**
      * Stops the auto capture thread.  
      * By default, no futher **frame** events will be emitted after this method has been called, since `clearBacklog` is `true` by default.  
@@ -2,11 +2,50 @@ const DesktopDuplicationNative = require('../build/Release/desktopduplication').
 const getMonitorCountNative = require('../build/Release/desktopduplication').getMonitorCount;
 const { EventEmitter } = require('events');
 
+const OUTPUT_FORMATS = [ "rgba8", "native", "nv12", "i420" ];
+const YUV_MATRICES = [ "bt601", "bt709" ];
+const YUV_RANGES = [ "limited", "full" ];
+
+function frameFromResult(res) {
+	return {
+		data: res.data,
+		width: res.width,
+		height: res.height,
+		format: res.format,
+		sourceFormat: res.sourceFormat,
+		sourceColorSpace: res.sourceColorSpace,
+		rotation: res.rotation,
+		planes: res.planes
+	};
+}
+
 class DesktopDuplication extends EventEmitter {
-	constructor(screenNum) {
+	constructor(screenNum, options = {}) {
 		super();
 
-		this._dd = new DesktopDuplicationNative(screenNum);
+		options = Object.assign({
+			hdr: false,
+			rotate: true,
+			outputFormat: "rgba8",
+			sdrWhiteLevel: 80,
+			maxLuminance: 1000,
+			yuvMatrix: "bt709",
+			yuvRange: "limited"
+		}, options);
+
+		if (!OUTPUT_FORMATS.includes(options.outputFormat)) {
+			throw new Error(`Unknown output format "${options.outputFormat}"`);
+		}
+
+		if (!YUV_MATRICES.includes(options.yuvMatrix)) {
+			throw new Error(`Unknown YUV matrix "${options.yuvMatrix}"`);
+		}
+
+		if (!YUV_RANGES.includes(options.yuvRange)) {
+			throw new Error(`Unknown YUV range "${options.yuvRange}"`);
+		}
+
+		this._dd = new DesktopDuplicationNative(screenNum, options);
 
 		this._autoCaptureStarted = false;
 		this._clearBacklog = true;
@@ -20,6 +59,18 @@ class DesktopDuplication extends EventEmitter {
 		this._dd.initialize();
 	}
 
+	initializeAsync() {
+		return new Promise((resolve, reject) => {
+			this._dd.initializeAsync(error => {
+				if (error) {
+					reject(new Error(error));
+				} else {
+					resolve();
+				}
+			});
+		});
+	}
+
 	getFrame(retryCount = 5) {
 		let res = this._dd.getFrame();
 
@@ -34,7 +85,7 @@ class DesktopDuplication extends EventEmitter {
 				}
 			case "accesslost":
 				if (retryCount > 0) {
-					this.initialize(); // initialize again
+					this._dd.reinitialize(); // duplicate the output again, reusing the device if possible
 					return this.getFrame(retryCount - 1); // try again
 				} else {
 					throw new Error("Access lost");
@@ -42,21 +93,13 @@ class DesktopDuplication extends EventEmitter {
 			case "success":
 				// check if the image is empty or all zeros, but only if we have retries left
 				if (retryCount > 0) {
-					if (res.data[0] + res.data[1] + res.data[2] + res.data[3] + res.data[4] + res.data[5] + res.data[6] + res.data[7] == 0) { // if the first two pixels are completely empty, we try again
+					if (res.planes.length == 1 && res.data[0] + res.data[1] + res.data[2] + res.data[3] + res.data[4] + res.data[5] + res.data[6] + res.data[7] == 0) { // if the first two pixels are completely empty, we try again (black is not all zeros in YUV)
 						return this.getFrame(retryCount - 1);
 					} else {
-						return {
-							data: res.data,
-							width: res.width,
-							height: res.height
-						};
+						return frameFromResult(res);
 					}
 				} else {
-					return {
-						data: res.data,
-						width: res.width,
-						height: res.height
-					};
+					return frameFromResult(res);
 				}				
 		}
 	}
@@ -76,7 +119,7 @@ class DesktopDuplication extends EventEmitter {
 					}
 				case "accesslost":
 					if (retryCount > 0) {
-						this.initialize(); // initialize again
+						this._dd.reinitialize(); // duplicate the output again, reusing the device if possible
 						return this.getFrameAsync(retryCount - 1); // try again
 					} else {
 						throw new Error("Access lost");
@@ -84,21 +127,13 @@ class DesktopDuplication extends EventEmitter {
 				case "success":
 					// check if the image is empty or all zeros, but only if we have retries left
 					if (retryCount > 0) {
-						if (res.data[0] + res.data[1] + res.data[2] + res.data[3] + res.data[4] + res.data[5] + res.data[6] + res.data[7] == 0) { // if the first two pixels are completely empty, we try again
+						if (res.planes.length == 1 && res.data[0] + res.data[1] + res.data[2] + res.data[3] + res.data[4] + res.data[5] + res.data[6] + res.data[7] == 0) { // if the first two pixels are completely empty, we try again (black is not all zeros in YUV)
 							return this.getFrameAsync(retryCount - 1);
 						} else {
-							return {
-								data: res.data,
-								width: res.width,
-								height: res.height
-							};
+							return frameFromResult(res);
 						}
 					} else {
-						return {
-							data: res.data,
-							width: res.width,
-							height: res.height
-						};
+						return frameFromResult(res);
 					}				
 			}
 		});
@@ -107,25 +142,49 @@ class DesktopDuplication extends EventEmitter {
 	startAutoCapture(delay, allowSkips=true) {
 		if (this._autoCaptureStarted) return;
 
-		this._dd.startAutoCapture(delay, allowSkips, frame => {
-			if (!this._autoCaptureStarted && this._clearBacklog) return;
-
-			if (frame.result == "success") {
-				setImmediate(() => {
-					this.emit("frame", {
-						data: frame.data,
-						width: frame.width,
-						height: frame.height
-					});
-				});
-			} else if (frame.result == "accesslost") {
-				this.stopAutoCapture(); // the thread has already exited at this point
-			}
-		});
+		this._dd.startAutoCapture(delay, allowSkips, frame => this._onAutoCaptureFrame(frame));
+
+		this._autoCaptureStarted = true;
+	}
+
+	startAdaptiveCapture(options = {}, allowSkips=true) {
+		if (this._autoCaptureStarted) return;
+
+		options = Object.assign({
+			minFps: 1,
+			maxFps: 30,
+			cpuBudget: 0.25
+		}, options);
+
+		if (!(options.minFps > 0) || !(options.maxFps >= options.minFps)) {
+			throw new Error("Invalid fps range");
+		}
+
+		if (!(options.cpuBudget > 0)) {
+			throw new Error("Invalid cpu budget");
+		}
+
+		this._dd.startAutoCapture(0, allowSkips, frame => this._onAutoCaptureFrame(frame), options);
 
 		this._autoCaptureStarted = true;
 	}
 
+	getAdaptiveCaptureState() {
+		return this._dd.getAdaptiveCaptureState();
+	}
+
+	_onAutoCaptureFrame(frame) {
+		if (!this._autoCaptureStarted && this._clearBacklog) return;
+
+		if (frame.result == "success") {
+			setImmediate(() => {
+				this.emit("frame", frameFromResult(frame));
+			});
+		} else if (frame.result == "accesslost") {
+			this.stopAutoCapture(); // the thread has already exited at this point
+		}
+	}
+
 	stopAutoCapture(clearBacklog=true) {
 		if (!this._autoCaptureStarted) return;
 
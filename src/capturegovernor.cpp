@@ -0,0 +1,151 @@
+#include "capturegovernor.h"
+
+#include <cmath>
+
+// weight of the newest sample in the moving averages
+#define GOVERNOR_SMOOTHING 0.25
+
+// the interval is cut quickly when the desktop starts changing and grows slowly while it is idle,
+// while a lagging consumer backs the rate off just as quickly as it was raised
+#define GOVERNOR_ATTACK 0.25
+#define GOVERNOR_DECAY 1.25
+#define GOVERNOR_BACKOFF 2.0
+
+CaptureGovernor::CaptureGovernor(const GOVERNOR_OPTIONS& options) :
+	m_LastDeliveryTime(-1)
+{
+	double minFps = (options.minFps > 0) ? options.minFps : 1;
+	double maxFps = (options.maxFps > minFps) ? options.maxFps : minFps;
+
+	m_MinInterval = 1000.0 / maxFps;
+	m_MaxInterval = 1000.0 / minFps;
+	m_CpuBudget = (options.cpuBudget > 0) ? options.cpuBudget : 1;
+
+	m_State.interval = m_MinInterval;
+	m_State.reason = GOVERNOR_STARTUP;
+	m_State.changeRate = 0;
+	m_State.processingTime = 0;
+	m_State.fps = 0;
+	m_State.pendingFrames = 0;
+	m_State.droppedFrames = 0;
+}
+
+const GOVERNOR_STATE& CaptureGovernor::update(const CAPTURE_SAMPLE& sample) {
+	m_State.changeRate += GOVERNOR_SMOOTHING * ((sample.changed ? 1.0 : 0.0) - m_State.changeRate);
+	m_State.pendingFrames = sample.pendingFrames;
+
+	if (sample.changed) {
+		if (m_State.processingTime == 0) {
+			m_State.processingTime = sample.processingTime;
+		} else {
+			m_State.processingTime += GOVERNOR_SMOOTHING * (sample.processingTime - m_State.processingTime);
+		}
+	}
+
+	if (sample.dropped) {
+		m_State.droppedFrames++;
+	} else if (sample.changed) {
+		if (m_LastDeliveryTime >= 0 && sample.time > m_LastDeliveryTime) {
+			double fps = 1000.0 / (sample.time - m_LastDeliveryTime);
+			m_State.fps = (m_State.fps == 0) ? fps : m_State.fps + GOVERNOR_SMOOTHING * (fps - m_State.fps);
+		}
+		m_LastDeliveryTime = sample.time;
+	}
+
+	double interval = m_State.interval;
+
+	if (sample.dropped || sample.pendingFrames > 0) {
+		interval *= GOVERNOR_BACKOFF;
+		m_State.reason = GOVERNOR_CONSUMER_LAG;
+	} else if (sample.changed) {
+		interval *= GOVERNOR_ATTACK;
+		m_State.reason = GOVERNOR_CHANGING;
+	} else {
+		interval *= GOVERNOR_DECAY;
+		m_State.reason = GOVERNOR_IDLE;
+	}
+
+	// don't capture more often than the conversion work fits into the budget
+	double budgetInterval = m_State.processingTime / m_CpuBudget;
+	if (interval < budgetInterval && budgetInterval > m_MinInterval) {
+		interval = budgetInterval;
+		m_State.reason = GOVERNOR_CPU_BUDGET;
+	}
+
+	// the fps range always wins, even over the cpu budget
+	if (interval < m_MinInterval) interval = m_MinInterval;
+	if (interval > m_MaxInterval) interval = m_MaxInterval;
+
+	m_State.interval = interval;
+
+	return m_State;
+}
+
+const GOVERNOR_STATE& CaptureGovernor::state() const {
+	return m_State;
+}
+
+CAPTURE_OUTCOME runCaptureStep(CaptureGovernor& governor, std::mutex& governorMutex, CaptureLoopBackend& backend) {
+	double start = backend.now();
+
+	double interval;
+	{
+		std::lock_guard<std::mutex> lock(governorMutex);
+		interval = governor.state().interval;
+	}
+
+	// wait for a new frame in short slices until the interval runs out, so a change on the desktop ends the wait
+	// right away while a stop request is still noticed quickly
+	double deadline = start + interval;
+	double processingTime = 0;
+	CAPTURE_OUTCOME outcome;
+
+	do {
+		double remaining = deadline - backend.now();
+		uint32_t timeout = (remaining <= 0) ? 0 : (remaining < ADAPTIVE_CAPTURE_MAX_TIMEOUT) ? (uint32_t)std::ceil(remaining) : ADAPTIVE_CAPTURE_MAX_TIMEOUT;
+
+		outcome = backend.acquireFrame(timeout, &processingTime);
+	} while (outcome == CAPTURE_TIMEOUT && backend.now() < deadline && !backend.stopRequested());
+
+	if (outcome == CAPTURE_ACCESSLOST) {
+		return outcome;
+	}
+
+	CAPTURE_SAMPLE sample;
+	sample.time = start;
+	sample.changed = (outcome == CAPTURE_FRAME);
+	sample.processingTime = sample.changed ? processingTime : 0;
+	sample.pendingFrames = backend.pendingFrames(); // read before the new frame is queued up
+	sample.dropped = sample.changed && !backend.deliverFrame();
+
+	{
+		std::lock_guard<std::mutex> lock(governorMutex);
+		interval = governor.update(sample).interval;
+	}
+
+	// a frame ends the wait early, the rest of the interval is what limits the capture rate
+	double waitTime = start + interval - backend.now();
+
+	if (waitTime > 0) {
+		backend.wait(waitTime);
+	}
+
+	return outcome;
+}
+
+const char* CaptureGovernor::reasonName(GOVERNOR_REASON reason) {
+	switch (reason) {
+		case GOVERNOR_STARTUP:
+			return "startup";
+		case GOVERNOR_CHANGING:
+			return "changing";
+		case GOVERNOR_IDLE:
+			return "idle";
+		case GOVERNOR_CONSUMER_LAG:
+			return "consumerlag";
+		case GOVERNOR_CPU_BUDGET:
+			return "cpubudget";
+		default:
+			return "unknown";
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+// The governor and the capture loop only talk to the outside world through timestamps, counters and the CaptureLoopBackend,
+// so they can be driven by a fake clock and a synthetic frame source.
+
+#include <cstdint>
+#include <mutex>
+
+// upper limit in ms for how long a capture attempt blocks while waiting for a new frame, so the loop can be stopped quickly
+#define ADAPTIVE_CAPTURE_MAX_TIMEOUT 100
+
+enum GOVERNOR_REASON {
+	GOVERNOR_STARTUP,
+	GOVERNOR_CHANGING,
+	GOVERNOR_IDLE,
+	GOVERNOR_CONSUMER_LAG,
+	GOVERNOR_CPU_BUDGET
+};
+
+typedef struct {
+	double minFps;
+	double maxFps;
+	double cpuBudget; // fraction of a single core that may be spent on copying and converting frames
+} GOVERNOR_OPTIONS;
+
+typedef struct {
+	double time; // timestamp of the capture attempt in ms
+	bool changed; // a new frame was captured, false if the capture timed out
+	double processingTime; // ms spent on copying and converting the frame
+	uint32_t pendingFrames; // frames handed to JS which it has not processed yet
+	bool dropped; // the frame had to be thrown away because JS was not keeping up
+} CAPTURE_SAMPLE;
+
+typedef struct {
+	double interval; // ms between the start of two capture attempts
+	GOVERNOR_REASON reason; // why the interval was last changed
+	double changeRate; // moving average of the fraction of capture attempts that returned a new frame
+	double processingTime; // moving average of the ms spent per captured frame
+	double fps; // moving average of the rate of delivered frames
+	uint32_t pendingFrames;
+	uint64_t droppedFrames;
+} GOVERNOR_STATE;
+
+class CaptureGovernor {
+	public:
+		CaptureGovernor(const GOVERNOR_OPTIONS& options);
+
+		// Feeds the outcome of one capture attempt into the controller and returns the updated state.
+		const GOVERNOR_STATE& update(const CAPTURE_SAMPLE& sample);
+		const GOVERNOR_STATE& state() const;
+
+		static const char* reasonName(GOVERNOR_REASON reason);
+
+	private:
+		double m_MinInterval;
+		double m_MaxInterval;
+		double m_CpuBudget;
+		double m_LastDeliveryTime;
+		GOVERNOR_STATE m_State;
+};
+
+enum CAPTURE_OUTCOME {
+	CAPTURE_FRAME, // a new frame was captured and converted
+	CAPTURE_TIMEOUT, // the desktop did not change
+	CAPTURE_ACCESSLOST, // the duplication has to be created again
+	CAPTURE_ERROR
+};
+
+class CaptureLoopBackend {
+	public:
+		virtual ~CaptureLoopBackend() {}
+
+		// current time in ms
+		virtual double now() = 0;
+		// Waits up to `timeout` ms for a changed frame and converts it, storing the time this took in `processingTime`.
+		virtual CAPTURE_OUTCOME acquireFrame(uint32_t timeout, double* processingTime) = 0;
+		// Hands the last captured frame to JS, returns false if it had to be dropped.
+		virtual bool deliverFrame() = 0;
+		// frames which were handed to JS, but not processed yet
+		virtual uint32_t pendingFrames() = 0;
+		// Waits for up to `duration` ms, returns false if the loop was stopped in the meantime.
+		virtual bool wait(double duration) = 0;
+		virtual bool stopRequested() = 0;
+};
+
+// Runs one iteration of the adaptive capture loop: waits for a changed frame for up to one interval, delivers it,
+// feeds the outcome into the governor and then waits for the rest of the new interval.
+// ACCESSLOST is returned right away without touching the governor, so the caller can create the duplication again.
+CAPTURE_OUTCOME runCaptureStep(CaptureGovernor& governor, std::mutex& governorMutex, CaptureLoopBackend& backend);
@@ -8,26 +8,102 @@ Napi::Number DesktopDuplication::getMonitorCount(const Napi::CallbackInfo &info)
 	return Napi::Number::New(env, (double)monitors);
 }
 
+void DesktopDuplication::setFrameResult(Napi::Env env, Napi::Object result, FRAME_DATA& frame) {
+	Napi::Buffer<char> buf = Napi::Buffer<char>::Copy(env, frame.data, frame.size);
+
+	free(frame.data);
+
+	result.Set("result", "success");
+	result.Set("data", buf);
+	result.Set("width", Napi::Number::New(env, (double)frame.width));
+	result.Set("height", Napi::Number::New(env, (double)frame.height));
+	result.Set("format", pixelFormatName(frame.format));
+	result.Set("sourceFormat", pixelFormatName(frame.sourceFormat));
+	result.Set("sourceColorSpace", colorSpaceName(frame.sourceColorSpace));
+	result.Set("rotation", Napi::Number::New(env, (double)(frame.rotation * 90)));
+
+	Napi::Array planes = Napi::Array::New(env, frame.planeCount);
+	for (uint32_t i = 0; i < frame.planeCount; i++) {
+		Napi::Object plane = Napi::Object::New(env);
+		plane.Set("offset", Napi::Number::New(env, (double)frame.planes[i].offset));
+		plane.Set("stride", Napi::Number::New(env, (double)frame.planes[i].pitch));
+		plane.Set("height", Napi::Number::New(env, (double)frame.planes[i].height));
+		planes.Set(i, plane);
+	}
+	result.Set("planes", planes);
+}
+
 DesktopDuplication::DesktopDuplication(const Napi::CallbackInfo &info) : 
 	Napi::ObjectWrap<DesktopDuplication>(info), 
+	m_Session(DeviceCache::shared(), *this),
 	m_Device(nullptr), 
 	m_Context(nullptr), 
+	m_Adapter(nullptr), 
 	m_DesktopDup(nullptr), 
 	m_LastImage(nullptr),
+	m_HasDesktopImage(false),
 	m_LastImageThread(nullptr),
 	m_stagingTextureThread(nullptr),
-	m_autoCaptureThreadStarted(false)
+	m_autoCaptureThreadStarted(false),
+	m_pendingFrames(0)
 {
 	UINT outputNum = info[0].As<Napi::Number>().Uint32Value();
 	m_OutputNumber = outputNum;
 
 	RtlZeroMemory(&m_OutputDesc, sizeof(m_OutputDesc));
+	m_ColorSpace = DXGI_COLOR_SPACE_RGB_FULL_G22_NONE_P709;
+
+	m_Options.hdr = false;
+	m_Options.rotate = true;
+	m_Options.outputFormat = OUTPUT_RGBA8;
+	m_Options.sdrWhiteLevel = 80.0f;
+	m_Options.maxLuminance = 1000.0f;
+	m_Options.yuvMatrix = YUV_MATRIX_BT709;
+	m_Options.yuvFullRange = false;
+
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object options = info[1].As<Napi::Object>();
+
+		if (options.Has("hdr")) {
+			m_Options.hdr = options.Get("hdr").ToBoolean().Value();
+		}
+		if (options.Has("rotate")) {
+			m_Options.rotate = options.Get("rotate").ToBoolean().Value();
+		}
+		if (options.Has("outputFormat")) {
+			std::string outputFormat = options.Get("outputFormat").ToString().Utf8Value();
+			if (outputFormat == "native") {
+				m_Options.outputFormat = OUTPUT_NATIVE;
+			} else if (outputFormat == "nv12") {
+				m_Options.outputFormat = OUTPUT_NV12;
+			} else if (outputFormat == "i420") {
+				m_Options.outputFormat = OUTPUT_I420;
+			}
+		}
+		if (options.Has("sdrWhiteLevel")) {
+			m_Options.sdrWhiteLevel = options.Get("sdrWhiteLevel").ToNumber().FloatValue();
+		}
+		if (options.Has("maxLuminance")) {
+			m_Options.maxLuminance = options.Get("maxLuminance").ToNumber().FloatValue();
+		}
+		if (options.Has("yuvMatrix") && options.Get("yuvMatrix").ToString().Utf8Value() == "bt601") {
+			m_Options.yuvMatrix = YUV_MATRIX_BT601;
+		}
+		if (options.Has("yuvRange") && options.Get("yuvRange").ToString().Utf8Value() == "full") {
+			m_Options.yuvFullRange = true;
+		}
+	}
 }
 
 std::string DesktopDuplication::initialize() {
-	// call cleanup so we can call this function multiple times without memory leaks
-	cleanUp();
+	return m_Session.initialize();
+}
 
+std::string DesktopDuplication::reinitialize() {
+	return m_Session.reinitialize();
+}
+
+BACKEND_RESULT DesktopDuplication::createDevice(DEVICE_HANDLE* device, std::string& error) {
 	HRESULT hr = S_OK;
 
 	// Driver types supported
@@ -49,82 +125,163 @@ std::string DesktopDuplication::initialize() {
 	UINT NumFeatureLevels = ARRAYSIZE(FeatureLevels);
 
 	D3D_FEATURE_LEVEL FeatureLevel;
+	ID3D11Device* Device = nullptr;
+	ID3D11DeviceContext* Context = nullptr;
 
 	// Create device
 	for (UINT DriverTypeIndex = 0; DriverTypeIndex < NumDriverTypes; ++DriverTypeIndex) {
-		hr = D3D11CreateDevice(nullptr, DriverTypes[DriverTypeIndex], nullptr, 0, FeatureLevels, NumFeatureLevels, D3D11_SDK_VERSION, &m_Device, &FeatureLevel, &m_Context);
+		hr = D3D11CreateDevice(nullptr, DriverTypes[DriverTypeIndex], nullptr, 0, FeatureLevels, NumFeatureLevels, D3D11_SDK_VERSION, &Device, &FeatureLevel, &Context);
 		if (SUCCEEDED(hr)) {
 			// Device creation success, no need to loop anymore
 			break;
 		}
 	}
 	if (FAILED(hr)) {
-		return "Failed to create device: " + std::system_category().message(hr);
+		error = "Failed to create device: " + std::system_category().message(hr);
+		return BACKEND_ERROR;
 	}
 
-	 // Get DXGI device
+	// serialize all calls on the immediate context, since every instance uses it from its own capture thread
+	ID3D10Multithread* Multithread = nullptr;
+	hr = Context->QueryInterface(__uuidof(ID3D10Multithread), reinterpret_cast<void**>(&Multithread));
+	Context->Release();
+	Context = nullptr;
+	if (FAILED(hr)) {
+		Device->Release();
+		error = "Failed to query interface for ID3D10Multithread: " + std::system_category().message(hr);
+		return BACKEND_ERROR;
+	}
+	Multithread->SetMultithreadProtected(TRUE);
+	Multithread->Release();
+	Multithread = nullptr;
+
+	*device = Device;
+
+	return BACKEND_OK;
+}
+
+void DesktopDuplication::retainDevice(DEVICE_HANDLE device) {
+	static_cast<ID3D11Device*>(device)->AddRef();
+}
+
+void DesktopDuplication::releaseDevice(DEVICE_HANDLE device) {
+	static_cast<ID3D11Device*>(device)->Release();
+}
+
+BACKEND_RESULT DesktopDuplication::deviceStatus(DEVICE_HANDLE device) {
+	return (static_cast<ID3D11Device*>(device)->GetDeviceRemovedReason() == S_OK) ? BACKEND_OK : BACKEND_DEVICE_REMOVED;
+}
+
+BACKEND_RESULT DesktopDuplication::duplicateOutput(DEVICE_HANDLE device, std::string& error) {
+	HRESULT hr = S_OK;
+
+	m_Device = static_cast<ID3D11Device*>(device);
+	m_Device->GetImmediateContext(&m_Context);
+
+	// Get DXGI device
 	IDXGIDevice* DxgiDevice = nullptr;
 	hr = m_Device->QueryInterface(__uuidof(IDXGIDevice), reinterpret_cast<void**>(&DxgiDevice));
 	if (FAILED(hr)) {
-		cleanUp();
-		return "Failed to query interface for DXGI Device: " + std::system_category().message(hr);
+		error = "Failed to query interface for DXGI Device: " + std::system_category().message(hr);
+		return BACKEND_ERROR;
 	}
 
 	// Get DXGI adapter
-	IDXGIAdapter* DxgiAdapter = nullptr;
-	hr = DxgiDevice->GetParent(__uuidof(IDXGIAdapter), reinterpret_cast<void**>(&DxgiAdapter));
+	hr = DxgiDevice->GetParent(__uuidof(IDXGIAdapter), reinterpret_cast<void**>(&m_Adapter));
 	DxgiDevice->Release();
 	DxgiDevice = nullptr;
 	if (FAILED(hr)) {
-		cleanUp();
-		return "Failed to get parent DXGI Adapter: " + std::system_category().message(hr);
+		m_Adapter = nullptr;
+		error = "Failed to get parent DXGI Adapter: " + std::system_category().message(hr);
+		return BACKEND_ERROR;
 	}
 
 	// Get output
 	IDXGIOutput* DxgiOutput = nullptr;
-	hr = DxgiAdapter->EnumOutputs(m_OutputNumber, &DxgiOutput);
-	DxgiAdapter->Release();
-	DxgiAdapter = nullptr;
+	hr = m_Adapter->EnumOutputs(m_OutputNumber, &DxgiOutput);
 	if (FAILED(hr)) {
-		cleanUp();
-		return "Failed to get specified output: " + std::system_category().message(hr);
+		error = "Failed to get specified output: " + std::system_category().message(hr);
+		return BACKEND_ERROR;
 	}
 
 	DxgiOutput->GetDesc(&m_OutputDesc);
 
+	// QI for Output 6 to find out if the output is in HDR mode (only available on Windows 10 1703 and newer)
+	m_ColorSpace = DXGI_COLOR_SPACE_RGB_FULL_G22_NONE_P709;
+	IDXGIOutput6* DxgiOutput6 = nullptr;
+	hr = DxgiOutput->QueryInterface(__uuidof(IDXGIOutput6), reinterpret_cast<void**>(&DxgiOutput6));
+	if (SUCCEEDED(hr)) {
+		DXGI_OUTPUT_DESC1 OutputDesc1;
+		if (SUCCEEDED(DxgiOutput6->GetDesc1(&OutputDesc1))) {
+			m_ColorSpace = OutputDesc1.ColorSpace;
+		}
+		DxgiOutput6->Release();
+		DxgiOutput6 = nullptr;
+	}
+
+	// QI for Output 5, which can duplicate the output in its native format instead of always converting to 8 bit BGRA
+	IDXGIOutput5* DxgiOutput5 = nullptr;
+	if (m_Options.hdr) {
+		hr = DxgiOutput->QueryInterface(__uuidof(IDXGIOutput5), reinterpret_cast<void**>(&DxgiOutput5));
+		if (FAILED(hr)) {
+			DxgiOutput5 = nullptr; // fall back to the regular duplication
+		}
+	}
+
 	// QI for Output 1
 	IDXGIOutput1* DxgiOutput1 = nullptr;
 	hr = DxgiOutput->QueryInterface(__uuidof(DxgiOutput1), reinterpret_cast<void**>(&DxgiOutput1));
 	DxgiOutput->Release();
 	DxgiOutput = nullptr;
 	if (FAILED(hr)) {
-		cleanUp();
-		return "Failed to query interface for DxgiOutput1: " + std::system_category().message(hr);
+		if (DxgiOutput5) {
+			DxgiOutput5->Release();
+		}
+		error = "Failed to query interface for DxgiOutput1: " + std::system_category().message(hr);
+		return BACKEND_ERROR;
 	}
 
 	// Create desktop duplication
-	hr = DxgiOutput1->DuplicateOutput(m_Device, &m_DesktopDup);
+	if (DxgiOutput5) {
+		DXGI_FORMAT SupportedFormats[] = {
+			DXGI_FORMAT_R16G16B16A16_FLOAT,
+			DXGI_FORMAT_R10G10B10A2_UNORM,
+			DXGI_FORMAT_B8G8R8A8_UNORM,
+		};
+
+		hr = DxgiOutput5->DuplicateOutput1(m_Device, 0, ARRAYSIZE(SupportedFormats), SupportedFormats, &m_DesktopDup);
+		DxgiOutput5->Release();
+		DxgiOutput5 = nullptr;
+
+		// DuplicateOutput1 also fails if the process is not per monitor DPI aware (e.g. plain node.exe), so fall back to the regular duplication
+		if (FAILED(hr) && hr != DXGI_ERROR_NOT_CURRENTLY_AVAILABLE) {
+			hr = DxgiOutput1->DuplicateOutput(m_Device, &m_DesktopDup);
+		}
+	} else {
+		hr = DxgiOutput1->DuplicateOutput(m_Device, &m_DesktopDup);
+	}
 	DxgiOutput1->Release();
 	DxgiOutput1 = nullptr;
 	if (FAILED(hr)) {
 		if (hr == DXGI_ERROR_NOT_CURRENTLY_AVAILABLE) {
-			return "There is already the maximum number of applications using the Desktop Duplication API running, please close one of those applications and then try again.";
+			error = "There is already the maximum number of applications using the Desktop Duplication API running, please close one of those applications and then try again.";
+			return BACKEND_ERROR;
+		}
+		error = "Failed to get duplicate output: " + std::system_category().message(hr);
+		if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET) {
+			return BACKEND_DEVICE_REMOVED;
+		}
+		// e.g. the secure desktop is shown or the display mode is just being changed
+		if (hr == E_ACCESSDENIED || hr == DXGI_ERROR_ACCESS_LOST) {
+			return BACKEND_ACCESSLOST;
 		}
-		cleanUp();
-		return "Failed to get duplicate output: " + std::system_category().message(hr);
+		return BACKEND_ERROR;
 	}
 
-#ifdef DEBUG_OUTPUT
-	std::cout << "Getting one frame to throw away immediately..." << std::endl;
-#endif
-
-	// throw away one frame which seems to always be empty
-	FRAME_DATA throwaway_frame = getFrame(1000);
-	if (throwaway_frame.result == RESULT_SUCCESS) {
-		free(throwaway_frame.data);
-	}
+	// the first frame after creating the duplication is often still empty, so frames are skipped until there is a desktop image
+	m_HasDesktopImage = false;
 
-	return "";
+	return BACKEND_OK;
 }
 
 void DesktopDuplication::wrap_initialize(const Napi::CallbackInfo &info) {
@@ -137,6 +294,25 @@ void DesktopDuplication::wrap_initialize(const Napi::CallbackInfo &info) {
 	}
 }
 
+void DesktopDuplication::initializeAsync(const Napi::CallbackInfo &info) {
+	Napi::Env env = info.Env();
+
+	Napi::Function callback = info[0].As<Napi::Function>();
+
+	InitializeAsyncWorker* worker = new InitializeAsyncWorker(this, callback);
+	worker->Queue();
+}
+
+void DesktopDuplication::wrap_reinitialize(const Napi::CallbackInfo &info) {
+	Napi::Env env = info.Env();
+
+	std::string error = reinitialize();
+
+	if (error != "") {
+		Napi::Error::New(env, error).ThrowAsJavaScriptException();
+	}
+}
+
 FRAME_DATA DesktopDuplication::getFrame(UINT timeout) {
 	FRAME_DATA result;	
 
@@ -165,6 +341,17 @@ FRAME_DATA DesktopDuplication::getFrame(UINT timeout) {
 		return result;
 	}
 
+	// skip the empty frames right after the duplication was created until the first desktop image was presented
+	if (!m_HasDesktopImage) {
+		if (FrameInfo.LastPresentTime.QuadPart == 0) {
+			DesktopResource->Release();
+			result.result = RESULT_TIMEOUT;
+			m_DesktopDup->ReleaseFrame();
+			return result;
+		}
+		m_HasDesktopImage = true;
+	}
+
 	// If still holding old frame, destroy it
 	if (m_LastImage) {
 		m_LastImage->Release();
@@ -227,7 +414,7 @@ FRAME_DATA DesktopDuplication::getFrame(UINT timeout) {
 	return result;
 }
 
-FRAME_DATA DesktopDuplication::getFrameThread(UINT timeout) {
+FRAME_DATA DesktopDuplication::getFrameThread(UINT timeout, bool resendOnTimeout, bool skipPointerUpdates) {
 	FRAME_DATA result;	
 
 	IDXGIResource* DesktopResource = nullptr;
@@ -242,7 +429,8 @@ FRAME_DATA DesktopDuplication::getFrameThread(UINT timeout) {
 		return result;
 	}
 
-	if (hr == DXGI_ERROR_WAIT_TIMEOUT && !m_stagingTextureThread) {
+	// without a new frame we can only send the previous one again
+	if (hr == DXGI_ERROR_WAIT_TIMEOUT && (!m_stagingTextureThread || !resendOnTimeout)) {
 		result.result = RESULT_TIMEOUT;
 		m_DesktopDup->ReleaseFrame();
 		return result;
@@ -256,6 +444,16 @@ FRAME_DATA DesktopDuplication::getFrameThread(UINT timeout) {
 			return result;
 		}
 
+		// skip the empty frames right after the duplication was created until the first desktop image was presented,
+		// and frames which only update the mouse pointer if the caller is only interested in changes of the desktop image
+		if (FrameInfo.LastPresentTime.QuadPart == 0 && (!m_HasDesktopImage || skipPointerUpdates)) {
+			DesktopResource->Release();
+			result.result = RESULT_TIMEOUT;
+			m_DesktopDup->ReleaseFrame();
+			return result;
+		}
+		m_HasDesktopImage = true;
+
 		// If still holding old frame, destroy it
 		if (m_LastImageThread) {
 			m_LastImageThread->Release();
@@ -317,6 +515,8 @@ FRAME_DATA DesktopDuplication::getFrameThread(UINT timeout) {
 FRAME_DATA DesktopDuplication::getFrameData(ID3D11Texture2D* texture, D3D11_TEXTURE2D_DESC& textureDesc) {
 	FRAME_DATA result;
 
+	auto start = std::chrono::high_resolution_clock::now();
+
 	D3D11_MAPPED_SUBRESOURCE resourceAccess;
 
 	HRESULT hr = m_Context->Map(texture, 0, D3D11_MAP_READ, 0, &resourceAccess);
@@ -327,12 +527,95 @@ FRAME_DATA DesktopDuplication::getFrameData(ID3D11Texture2D* texture, D3D11_TEXT
 		return result;
 	}
 
+	CONVERSION_PARAMS params;
+	params.rotation = ROTATION_NONE;
+	params.sdrWhiteLevel = m_Options.sdrWhiteLevel;
+	params.maxLuminance = m_Options.maxLuminance;
+
+	switch (textureDesc.Format) {
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+			params.format = PIXEL_FORMAT_BGRA8;
+			params.colorSpace = COLOR_SPACE_SRGB;
+			break;
+		case DXGI_FORMAT_R10G10B10A2_UNORM:
+			params.format = PIXEL_FORMAT_RGB10A2;
+			params.colorSpace = (m_ColorSpace == DXGI_COLOR_SPACE_RGB_FULL_G2084_NONE_P2020) ? COLOR_SPACE_PQ : COLOR_SPACE_SRGB;
+			break;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+			params.format = PIXEL_FORMAT_RGBA16F;
+			params.colorSpace = COLOR_SPACE_SCRGB;
+			break;
+		default:
+			m_Context->Unmap(texture, 0);
+			result.result = RESULT_ERROR;
+			result.error = "Unsupported surface format: " + std::to_string(textureDesc.Format);
+			return result;
+	}
+
+	// the duplicated surface is always in scan-out orientation, so rotated monitors have to be rotated back into desktop orientation
+	if (m_Options.rotate) {
+		switch (m_OutputDesc.Rotation) {
+			case DXGI_MODE_ROTATION_ROTATE90:
+				params.rotation = ROTATION_90;
+				break;
+			case DXGI_MODE_ROTATION_ROTATE180:
+				params.rotation = ROTATION_180;
+				break;
+			case DXGI_MODE_ROTATION_ROTATE270:
+				params.rotation = ROTATION_270;
+				break;
+			default:
+				break;
+		}
+	}
+
+	bool swapDimensions = (params.rotation == ROTATION_90 || params.rotation == ROTATION_270);
+	UINT outputWidth = swapDimensions ? textureDesc.Height : textureDesc.Width;
+	UINT outputHeight = swapDimensions ? textureDesc.Width : textureDesc.Height;
+
+	PIXEL_FORMAT outputFormat;
+	switch (m_Options.outputFormat) {
+		case OUTPUT_NATIVE:
+			outputFormat = params.format;
+			break;
+		case OUTPUT_NV12:
+			outputFormat = PIXEL_FORMAT_NV12;
+			break;
+		case OUTPUT_I420:
+			outputFormat = PIXEL_FORMAT_I420;
+			break;
+		default:
+			outputFormat = PIXEL_FORMAT_RGBA8;
+			break;
+	}
+
+	YUV_PARAMS yuv;
+	yuv.layout = (outputFormat == PIXEL_FORMAT_I420) ? YUV_LAYOUT_I420 : YUV_LAYOUT_NV12;
+	yuv.matrix = m_Options.yuvMatrix;
+	yuv.fullRange = m_Options.yuvFullRange;
+
+	bool planar = (outputFormat == PIXEL_FORMAT_NV12 || outputFormat == PIXEL_FORMAT_I420);
+	size_t outputRowBytes = (size_t)outputWidth * bytesPerPixel(outputFormat);
+	size_t outputSize;
+
+	if (planar) {
+		outputSize = yuvPlaneLayout(yuv.layout, outputWidth, outputHeight, result.planes, &result.planeCount);
+	} else {
+		outputSize = outputRowBytes * outputHeight;
+
+		result.planeCount = 1;
+		result.planes[0].offset = 0;
+		result.planes[0].pitch = outputRowBytes;
+		result.planes[0].height = outputHeight;
+	}
+
 #ifdef DEBUG_OUTPUT
 	std::cout << "getFrameData" << std::endl;
-	std::cout << "\twidth=" << textureDesc.Width << " height=" << textureDesc.Height << " imgData_size=" << (textureDesc.Width * textureDesc.Height * 4) << std::endl;
+	std::cout << "\twidth=" << textureDesc.Width << " height=" << textureDesc.Height << " format=" << pixelFormatName(params.format) << " rotation=" << (params.rotation * 90) << " imgData_size=" << outputSize << std::endl;
 #endif
 
-	void* imgData = malloc(textureDesc.Width * textureDesc.Height * 4);
+	void* imgData = malloc(outputSize);
 
 	if (imgData == NULL) {
 		m_Context->Unmap(texture, 0);
@@ -341,31 +624,36 @@ FRAME_DATA DesktopDuplication::getFrameData(ID3D11Texture2D* texture, D3D11_TEXT
 		return result;
 	}
 
-	// copy data row by row into the target buffer
-	char* p = (char*)resourceAccess.pData;
-	for (uint32_t y = 0; y < textureDesc.Height; y++) {
-		memcpy((char*)imgData + y * textureDesc.Width * 4, p, textureDesc.Width * 4);
-		p += resourceAccess.RowPitch;
+	const uint8_t* src = reinterpret_cast<const uint8_t*>(resourceAccess.pData);
+	uint8_t* dst = reinterpret_cast<uint8_t*>(imgData);
+
+	if (m_Options.outputFormat == OUTPUT_NATIVE) {
+		// copy data row by row into the target buffer
+		copyRotated(src, resourceAccess.RowPitch, dst, outputRowBytes, textureDesc.Width, textureDesc.Height, bytesPerPixel(outputFormat), params.rotation);
+	} else if (planar) {
+		// convert straight from the mapped rows to 4:2:0 YUV for video encoders
+		convertToYUV420(src, resourceAccess.RowPitch, dst, result.planes, textureDesc.Width, textureDesc.Height, params, yuv);
+	} else {
+		// convert from the surface format to RGBA and rotate while copying
+		convertToRGBA8(src, resourceAccess.RowPitch, dst, outputRowBytes, textureDesc.Width, textureDesc.Height, params);
 	}
 
 	char* data = reinterpret_cast<char*>(imgData);
 
-	// change memory layout from BGRA to RGBA
-
-	char temp;
-	for(uint32_t i = 0; i < textureDesc.Width * textureDesc.Height * 4; i += 4) {
-		temp = data[i + 2];
-		data[i + 2] = data[i];
-		data[i] = temp;
-	}
-
 	result.result = RESULT_SUCCESS;
 	result.data = data;
-	result.width = textureDesc.Width;
-	result.height = textureDesc.Height;
+	result.size = outputSize;
+	result.width = outputWidth;
+	result.height = outputHeight;
+	result.format = outputFormat;
+	result.sourceFormat = params.format;
+	result.sourceColorSpace = params.colorSpace;
+	result.rotation = params.rotation;
 
 	m_Context->Unmap(texture, 0);
 
+	result.processingTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
 	return result;
 }
 
@@ -398,17 +686,9 @@ Napi::Value DesktopDuplication::wrap_getFrame(const Napi::CallbackInfo &info) {
 			result.Set("result", "error");
 			result.Set("error", Napi::String::New(env, frame.error));
 			return result;
-		case RESULT_SUCCESS: {
-			Napi::Buffer<char> buf = Napi::Buffer<char>::Copy(env, frame.data, frame.width * frame.height * 4);
-
-			free(frame.data);
-
-			result.Set("result", "success");
-			result.Set("data", buf);
-			result.Set("width", Napi::Number::New(env, (double)frame.width));
-			result.Set("height", Napi::Number::New(env, (double)frame.height));
+		case RESULT_SUCCESS:
+			setFrameResult(env, result, frame);
 			return result;
-		}
 		default:
 			return env.Null();
 	}
@@ -429,7 +709,31 @@ Napi::Value DesktopDuplication::startAutoCapture(const Napi::CallbackInfo &info)
 
 	m_autoCaptureThreadSignal = std::promise<void>();
 
-	m_autoCaptureThread = std::thread(&DesktopDuplication::autoCaptureFn, this, delay);
+	m_pendingFrames = 0;
+
+	// passing governor options switches from a fixed delay to the adaptive capture rate
+	if (info.Length() > 3 && info[3].IsObject()) {
+		Napi::Object options = info[3].As<Napi::Object>();
+
+		GOVERNOR_OPTIONS governorOptions;
+		governorOptions.minFps = options.Get("minFps").ToNumber().DoubleValue();
+		governorOptions.maxFps = options.Get("maxFps").ToNumber().DoubleValue();
+		governorOptions.cpuBudget = options.Get("cpuBudget").ToNumber().DoubleValue();
+
+		{
+			std::lock_guard<std::mutex> lock(m_governorMutex);
+			m_governor.reset(new CaptureGovernor(governorOptions));
+		}
+
+		m_autoCaptureThread = std::thread(&DesktopDuplication::adaptiveCaptureFn, this);
+	} else {
+		{
+			std::lock_guard<std::mutex> lock(m_governorMutex);
+			m_governor.reset();
+		}
+
+		m_autoCaptureThread = std::thread(&DesktopDuplication::autoCaptureFn, this, delay);
+	}
 
 	m_autoCaptureThreadStarted = true;
 
@@ -460,17 +764,41 @@ Napi::Value DesktopDuplication::wrap_stopAutoCapture(const Napi::CallbackInfo &i
 	return Napi::Boolean::New(env, result);
 }
 
-DesktopDuplication::~DesktopDuplication() {
-	cleanUp();
+Napi::Value DesktopDuplication::getAdaptiveCaptureState(const Napi::CallbackInfo &info) {
+	Napi::Env env = info.Env();
+
+	std::lock_guard<std::mutex> lock(m_governorMutex);
 
+	if (!m_governor) {
+		return env.Null();
+	}
+
+	const GOVERNOR_STATE& state = m_governor->state();
+
+	Napi::Object result = Napi::Object::New(env);
+	result.Set("interval", Napi::Number::New(env, state.interval));
+	result.Set("reason", CaptureGovernor::reasonName(state.reason));
+	result.Set("changeRate", Napi::Number::New(env, state.changeRate));
+	result.Set("processingTime", Napi::Number::New(env, state.processingTime));
+	result.Set("fps", Napi::Number::New(env, state.fps));
+	result.Set("pendingFrames", Napi::Number::New(env, (double)state.pendingFrames));
+	result.Set("droppedFrames", Napi::Number::New(env, (double)state.droppedFrames));
+
+	return result;
+}
+
+DesktopDuplication::~DesktopDuplication() {
+	// stop the capture thread first, it still uses the duplication
 	if (m_autoCaptureThreadStarted) {
 		m_autoCaptureThreadSignal.set_value();
 
 		m_autoCaptureThread.join();
 	}
+
+	m_Session.cleanUp();
 }
 
-void DesktopDuplication::cleanUp() {
+void DesktopDuplication::releaseDuplication() {
 	if (m_DesktopDup) {
 		m_DesktopDup->Release();
 		m_DesktopDup = nullptr;
@@ -481,16 +809,6 @@ void DesktopDuplication::cleanUp() {
 		m_LastImage = nullptr;
 	}
 
-	if (m_Device) {
-		m_Device->Release();
-		m_Device = nullptr;
-	}
-
-	if (m_Context) {
-		m_Context->Release();
-		m_Context = nullptr;
-	}
-
 	if (m_LastImageThread) {
 		m_LastImageThread->Release();
 		m_LastImageThread = nullptr;
@@ -500,6 +818,18 @@ void DesktopDuplication::cleanUp() {
 		m_stagingTextureThread->Release();
 		m_stagingTextureThread = nullptr;
 	}
+
+	if (m_Adapter) {
+		m_Adapter->Release();
+		m_Adapter = nullptr;
+	}
+
+	if (m_Context) {
+		m_Context->Release();
+		m_Context = nullptr;
+	}
+
+	m_Device = nullptr;
 }
 
 void DesktopDuplication::autoCaptureFnJsCallback(Napi::Env env, Napi::Function fn, FRAME_DATA* frame) {
@@ -510,16 +840,10 @@ void DesktopDuplication::autoCaptureFnJsCallback(Napi::Env env, Napi::Function f
 	switch(frame->result) {
 		case RESULT_ACCESSLOST:
 			result.Set("result", "accesslost");
-		case RESULT_SUCCESS: {
-			Napi::Buffer<char> buf = Napi::Buffer<char>::Copy(env, frame->data, frame->width * frame->height * 4);
-
-			free(frame->data);
-
-			result.Set("result", "success");
-			result.Set("data", buf);
-			result.Set("width", Napi::Number::New(env, (double)frame->width));
-			result.Set("height", Napi::Number::New(env, (double)frame->height));
-		}
+			break;
+		case RESULT_SUCCESS:
+			setFrameResult(env, result, *frame);
+			break;
 	}
 
 	fn.Call({ result });
@@ -538,23 +862,10 @@ void DesktopDuplication::autoCaptureFn(int delay) {
 		if (frame.result != RESULT_SUCCESS) {
 			if (frame.result == RESULT_ACCESSLOST) {
 				// try to reinitialize automatically
-				std::string error = initialize();
+				std::string error = reinitialize();
 				if (error != "") {
 					// can't reinitialize, end thread execution and notify node
-					void* fd_clone_buffer = malloc(sizeof(FRAME_DATA));
-
-					if (fd_clone_buffer != NULL) { 
-						FRAME_DATA* fd_clone = reinterpret_cast<FRAME_DATA*>(fd_clone_buffer);
-						memcpy(fd_clone, &frame, sizeof(FRAME_DATA));
-
-						napi_status status = m_autoCaptureThreadCallback.NonBlockingCall( fd_clone, autoCaptureFnJsCallback );
-
-						if (status != napi_ok) {
-							// free data manually if we can't transfer the responsibility to the GC
-							free(fd_clone);
-						}
-					} // else: can't allocate anything, so we can't even notify node
-
+					queueFrame(frame);
 					return;
 				}
 			}
@@ -572,20 +883,7 @@ void DesktopDuplication::autoCaptureFn(int delay) {
 			continue;
 		}
 
-		void* fd_clone_buffer = malloc(sizeof(FRAME_DATA));
-
-		if (fd_clone_buffer != NULL) { 
-			FRAME_DATA* fd_clone = reinterpret_cast<FRAME_DATA*>(fd_clone_buffer);
-			memcpy(fd_clone, &frame, sizeof(FRAME_DATA));
-
-			napi_status status = m_autoCaptureThreadCallback.NonBlockingCall( fd_clone, autoCaptureFnJsCallback );
-
-			if (status != napi_ok) {
-				// free data manually if we can't transfer the responsibility to the GC
-				free(frame.data);
-				free(fd_clone);
-			}
-		}
+		queueFrame(frame);
 
 		auto finish = std::chrono::high_resolution_clock::now();
 
@@ -603,15 +901,131 @@ void DesktopDuplication::autoCaptureFn(int delay) {
 	}
 }
 
+// Connects the adaptive capture loop to the duplication and the JS callback.
+class AdaptiveCaptureBackend : public CaptureLoopBackend {
+	public:
+		AdaptiveCaptureBackend(DesktopDuplication* target, std::future<void>& signal) :
+			m_DeskDup(target),
+			m_Signal(signal),
+			m_Epoch(std::chrono::high_resolution_clock::now())
+		{
+			m_Frame.result = RESULT_TIMEOUT;
+		}
+
+		double now() {
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_Epoch).count();
+		}
+
+		CAPTURE_OUTCOME acquireFrame(uint32_t timeout, double* processingTime) {
+			// unchanged frames and pointer movements are not sent again, since the governor backs off while the desktop is idle
+			m_Frame = m_DeskDup->getFrameThread(timeout, false, true);
+
+			switch (m_Frame.result) {
+				case RESULT_SUCCESS:
+					*processingTime = m_Frame.processingTime;
+					return CAPTURE_FRAME;
+				case RESULT_TIMEOUT:
+					return CAPTURE_TIMEOUT;
+				case RESULT_ACCESSLOST:
+					return CAPTURE_ACCESSLOST;
+				default:
+					return CAPTURE_ERROR;
+			}
+		}
+
+		bool deliverFrame() {
+			return m_DeskDup->queueFrame(m_Frame) == napi_ok;
+		}
+
+		uint32_t pendingFrames() {
+			return m_DeskDup->m_pendingFrames;
+		}
+
+		bool wait(double duration) {
+			return m_Signal.wait_for(std::chrono::duration<double, std::milli>(duration)) == std::future_status::timeout;
+		}
+
+		bool stopRequested() {
+			return m_Signal.wait_for(std::chrono::milliseconds(0)) != std::future_status::timeout;
+		}
+
+		FRAME_DATA& frame() {
+			return m_Frame;
+		}
+
+	private:
+		DesktopDuplication* m_DeskDup;
+		std::future<void>& m_Signal;
+		std::chrono::high_resolution_clock::time_point m_Epoch;
+		FRAME_DATA m_Frame;
+};
+
+void DesktopDuplication::adaptiveCaptureFn() {
+	std::future<void> signal = m_autoCaptureThreadSignal.get_future();
+
+	AdaptiveCaptureBackend backend(this, signal);
+
+	while (!backend.stopRequested()) {
+		CAPTURE_OUTCOME outcome = runCaptureStep(*m_governor, m_governorMutex, backend);
+
+		if (outcome == CAPTURE_ACCESSLOST) {
+			// try to reinitialize automatically
+			std::string error = reinitialize();
+			if (error != "") {
+				// can't reinitialize, end thread execution and notify node
+				queueFrame(backend.frame());
+				return;
+			}
+		}
+	}
+}
+
+napi_status DesktopDuplication::queueFrame(FRAME_DATA& frame) {
+	void* fd_clone_buffer = malloc(sizeof(FRAME_DATA));
+
+	if (fd_clone_buffer == NULL) {
+		// can't allocate anything, so we can't even notify node
+		if (frame.result == RESULT_SUCCESS) {
+			free(frame.data);
+		}
+		return napi_generic_failure;
+	}
+
+	FRAME_DATA* fd_clone = reinterpret_cast<FRAME_DATA*>(fd_clone_buffer);
+	memcpy(fd_clone, &frame, sizeof(FRAME_DATA));
+
+	m_pendingFrames++;
+
+	napi_status status = m_autoCaptureThreadCallback.NonBlockingCall(fd_clone, [this](Napi::Env env, Napi::Function fn, FRAME_DATA* queuedFrame) {
+		m_pendingFrames--;
+		autoCaptureFnJsCallback(env, fn, queuedFrame);
+	});
+
+	if (status != napi_ok) {
+		m_pendingFrames--;
+
+		// free data manually if we can't transfer the responsibility to the GC
+		if (frame.result == RESULT_SUCCESS) {
+			free(frame.data);
+		}
+		free(fd_clone);
+	}
+
+	return status;
+}
+
 Napi::FunctionReference DesktopDuplication::constructor;
 
 Napi::Object DesktopDuplication::Init(Napi::Env env, Napi::Object exports) {
 	Napi::Function func = DefineClass(env, "DesktopDuplication", {
 		InstanceMethod("initialize", &DesktopDuplication::wrap_initialize),
+		InstanceMethod("initializeAsync", &DesktopDuplication::initializeAsync),
+		InstanceMethod("reinitialize", &DesktopDuplication::wrap_reinitialize),
 		InstanceMethod("getFrame", &DesktopDuplication::wrap_getFrame),
 		InstanceMethod("getFrameAsync", &DesktopDuplication::getFrameAsync),
 		InstanceMethod("startAutoCapture", &DesktopDuplication::startAutoCapture),
 		InstanceMethod("stopAutoCapture", &DesktopDuplication::wrap_stopAutoCapture),
+		InstanceMethod("getAdaptiveCaptureState", &DesktopDuplication::getAdaptiveCaptureState),
 	});
 
 	constructor = Napi::Persistent(func);
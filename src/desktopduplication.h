@@ -2,49 +2,76 @@
 
 #include "napi.h"
 
+#include <d3d10.h>
 #include <d3d11.h>
-#include <dxgi1_2.h>
+#include <dxgi1_6.h>
 #include <iostream>
 #include <system_error>
+#include <atomic>
+#include <memory>
+#include <mutex>
 
 #include "types.h"
+#include "capturegovernor.h"
+#include "devicecache.h"
 #include "getframeasyncworker.h"
+#include "initializeasyncworker.h"
 
 // #define DEBUG_OUTPUT
 
-class DesktopDuplication : public Napi::ObjectWrap<DesktopDuplication> {
+class DesktopDuplication : public Napi::ObjectWrap<DesktopDuplication>, private DeviceBackend {
 	public:
 		static Napi::Object Init(Napi::Env env, Napi::Object exports);
 		
 		static Napi::Number getMonitorCount(const Napi::CallbackInfo &info);
+		static void setFrameResult(Napi::Env env, Napi::Object result, FRAME_DATA& frame);
 
 		DesktopDuplication(const Napi::CallbackInfo &info);
 		std::string initialize();
+		std::string reinitialize();
 		void wrap_initialize(const Napi::CallbackInfo &info);
+		void initializeAsync(const Napi::CallbackInfo &info);
+		void wrap_reinitialize(const Napi::CallbackInfo &info);
 		FRAME_DATA getFrame(UINT timeout);
-		FRAME_DATA getFrameThread(UINT timeout);
+		FRAME_DATA getFrameThread(UINT timeout, bool resendOnTimeout = true, bool skipPointerUpdates = false);
 		Napi::Value wrap_getFrame(const Napi::CallbackInfo &info);
 		void getFrameAsync(const Napi::CallbackInfo &info);
 		Napi::Value startAutoCapture(const Napi::CallbackInfo &info);
 		bool stopAutoCapture();
 		Napi::Value wrap_stopAutoCapture(const Napi::CallbackInfo &info);
+		Napi::Value getAdaptiveCaptureState(const Napi::CallbackInfo &info);
 
 		~DesktopDuplication();
 
 	private:
+		friend class AdaptiveCaptureBackend;
+
 		static Napi::FunctionReference constructor;
 		static void autoCaptureFnJsCallback(Napi::Env env, Napi::Function fn, FRAME_DATA* frame);
 
-		void cleanUp();
+		// DeviceBackend on top of D3D11 and DXGI, called by m_Session
+		BACKEND_RESULT createDevice(DEVICE_HANDLE* device, std::string& error);
+		void retainDevice(DEVICE_HANDLE device);
+		void releaseDevice(DEVICE_HANDLE device);
+		BACKEND_RESULT deviceStatus(DEVICE_HANDLE device);
+		BACKEND_RESULT duplicateOutput(DEVICE_HANDLE device, std::string& error);
+		void releaseDuplication();
 		void autoCaptureFn(int delay);
+		void adaptiveCaptureFn();
+		napi_status queueFrame(FRAME_DATA& frame);
 		FRAME_DATA getFrameData(ID3D11Texture2D* texture, D3D11_TEXTURE2D_DESC& textureDesc);
 
-		ID3D11Device* m_Device;
+		DuplicationSession m_Session;
+		ID3D11Device* m_Device; // owned by m_Session
 		ID3D11DeviceContext* m_Context;
+		IDXGIAdapter* m_Adapter;
 		IDXGIOutputDuplication* m_DesktopDup;
 		UINT m_OutputNumber;
 		DXGI_OUTPUT_DESC m_OutputDesc;
+		DXGI_COLOR_SPACE_TYPE m_ColorSpace;
+		CAPTURE_OPTIONS m_Options;
 		ID3D11Texture2D* m_LastImage;
+		std::atomic<bool> m_HasDesktopImage;
 
 		ID3D11Texture2D* m_LastImageThread;
 		ID3D11Texture2D* m_stagingTextureThread;
@@ -53,4 +80,8 @@ class DesktopDuplication : public Napi::ObjectWrap<DesktopDuplication> {
 		bool m_autoCaptureThreadStarted;
 		std::promise<void> m_autoCaptureThreadSignal;
 		Napi::ThreadSafeFunction m_autoCaptureThreadCallback;
+		std::atomic<uint32_t> m_pendingFrames;
+
+		std::unique_ptr<CaptureGovernor> m_governor;
+		std::mutex m_governorMutex;
 };
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "devicecache.h"
+
+DeviceCache::DeviceCache() :
+	m_Device(nullptr)
+{
+}
+
+std::string DeviceCache::acquire(DeviceBackend& backend, DEVICE_HANDLE* device) {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// a removed device can't be used anymore, so start over with a fresh one
+	if (m_Device && backend.deviceStatus(m_Device) != BACKEND_OK) {
+		backend.releaseDevice(m_Device);
+		m_Device = nullptr;
+	}
+
+	if (!m_Device) {
+		std::string error;
+		if (backend.createDevice(&m_Device, error) != BACKEND_OK) {
+			m_Device = nullptr;
+			return error;
+		}
+	}
+
+	backend.retainDevice(m_Device);
+	*device = m_Device;
+
+	return "";
+}
+
+DeviceCache& DeviceCache::shared() {
+	static DeviceCache cache;
+	return cache;
+}
+
+DuplicationSession::DuplicationSession(DeviceCache& cache, DeviceBackend& backend) :
+	m_Cache(cache),
+	m_Backend(backend),
+	m_Device(nullptr)
+{
+}
+
+std::string DuplicationSession::initialize() {
+	// call cleanup so we can call this function multiple times without memory leaks
+	cleanUp();
+
+	std::string error = m_Cache.acquire(m_Backend, &m_Device);
+	if (error != "") {
+		m_Device = nullptr;
+		return error;
+	}
+
+	if (m_Backend.duplicateOutput(m_Device, error) != BACKEND_OK) {
+		cleanUp();
+		return error;
+	}
+
+	return "";
+}
+
+std::string DuplicationSession::reinitialize() {
+	// fast path: if the device survived, only the duplication has to be created again (e.g. after a mode change)
+	if (m_Device && m_Backend.deviceStatus(m_Device) == BACKEND_OK) {
+		m_Backend.releaseDuplication();
+
+		std::string error;
+		BACKEND_RESULT result = m_Backend.duplicateOutput(m_Device, error);
+		if (result == BACKEND_OK) {
+			return "";
+		}
+
+		// a new device would not be able to duplicate the output either, so keep the current one for the next attempt
+		if (result == BACKEND_ACCESSLOST) {
+			return error;
+		}
+	}
+
+	return initialize();
+}
+
+void DuplicationSession::cleanUp() {
+	m_Backend.releaseDuplication();
+
+	if (m_Device) {
+		m_Backend.releaseDevice(m_Device);
+		m_Device = nullptr;
+	}
+}
+
+DEVICE_HANDLE DuplicationSession::device() const {
+	return m_Device;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+// The device cache and the reinitialization logic only see opaque handles and the DeviceBackend, so they don't depend on
+// Windows and can be driven by a mock backend. DesktopDuplication implements the backend on top of D3D11 and DXGI.
+
+#include <mutex>
+#include <string>
+
+// a referenced device, e.g. an ID3D11Device*
+typedef void* DEVICE_HANDLE;
+
+enum BACKEND_RESULT {
+	BACKEND_OK,
+	BACKEND_DEVICE_REMOVED, // the device can't be used anymore (driver update, GPU reset, ...)
+	BACKEND_ACCESSLOST, // the output can't be duplicated right now (mode change, secure desktop, ...)
+	BACKEND_ERROR
+};
+
+class DeviceBackend {
+	public:
+		virtual ~DeviceBackend() {}
+
+		// Creates a new device which holds one reference, `error` describes why it failed.
+		virtual BACKEND_RESULT createDevice(DEVICE_HANDLE* device, std::string& error) = 0;
+		virtual void retainDevice(DEVICE_HANDLE device) = 0;
+		virtual void releaseDevice(DEVICE_HANDLE device) = 0;
+		// BACKEND_OK as long as the device can still be used, BACKEND_DEVICE_REMOVED otherwise
+		virtual BACKEND_RESULT deviceStatus(DEVICE_HANDLE device) = 0;
+
+		// Duplicates the output of this instance on the device, `error` describes why it failed.
+		virtual BACKEND_RESULT duplicateOutput(DEVICE_HANDLE device, std::string& error) = 0;
+		virtual void releaseDuplication() = 0;
+};
+
+// Creating the D3D device is the slowest part of the initialization, so a single device on the default adapter is shared
+// by all DesktopDuplication instances in the process.
+class DeviceCache {
+	public:
+		DeviceCache();
+
+		// Returns a referenced handle to the shared device, which has to be released by the caller.
+		// A new device is created on the first call and whenever the previous one was removed.
+		std::string acquire(DeviceBackend& backend, DEVICE_HANDLE* device);
+
+		// the cache used by all instances, its device is kept until the process exits
+		static DeviceCache& shared();
+
+	private:
+		std::mutex m_Mutex;
+		DEVICE_HANDLE m_Device;
+};
+
+// Holds the device of one DesktopDuplication and decides how much has to be created again after the duplication was lost.
+class DuplicationSession {
+	public:
+		DuplicationSession(DeviceCache& cache, DeviceBackend& backend);
+
+		// Releases everything, then duplicates the output on the shared device.
+		std::string initialize();
+		// Only creates the duplication again if the device survived, and falls back to initialize() otherwise.
+		std::string reinitialize();
+		void cleanUp();
+
+		DEVICE_HANDLE device() const;
+
+	private:
+		DeviceCache& m_Cache;
+		DeviceBackend& m_Backend;
+		DEVICE_HANDLE m_Device;
+};
@@ -24,17 +24,9 @@ std::vector<napi_value> GetFrameAsyncWorker::GetResult(Napi::Env env) {
 			result.Set("result", "error");
 			result.Set("error", Napi::String::New(env, m_Frame.error));
 			return { result };
-		case RESULT_SUCCESS: {
-			Napi::Buffer<char> buf = Napi::Buffer<char>::Copy(env, m_Frame.data, m_Frame.width * m_Frame.height * 4);
-
-			free(m_Frame.data);
-
-			result.Set("result", "success");
-			result.Set("data", buf);
-			result.Set("width", Napi::Number::New(env, (double)m_Frame.width));
-			result.Set("height", Napi::Number::New(env, (double)m_Frame.height));
+		case RESULT_SUCCESS:
+			DesktopDuplication::setFrameResult(env, result, m_Frame);
 			return { result };
-		}
 		default:
 			return { env.Null() };
 	}
@@ -0,0 +1,17 @@
+#include "initializeasyncworker.h"
+
+InitializeAsyncWorker::InitializeAsyncWorker(DesktopDuplication* target, Napi::Function callback) : Napi::AsyncWorker(callback), m_DeskDup(target) {
+
+}
+
+void InitializeAsyncWorker::Execute() {
+	m_Error = m_DeskDup->initialize();
+}
+
+std::vector<napi_value> InitializeAsyncWorker::GetResult(Napi::Env env) {
+	if (m_Error != "") {
+		return { Napi::String::New(env, m_Error) };
+	}
+
+	return { env.Null() };
+}
\ No newline at end of file
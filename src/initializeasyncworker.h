@@ -0,0 +1,19 @@
+#pragma once
+
+#include "napi.h"
+#include "desktopduplication.h"
+
+class DesktopDuplication;
+
+class InitializeAsyncWorker : public Napi::AsyncWorker {
+	public:
+		InitializeAsyncWorker(DesktopDuplication* target, Napi::Function callback);
+
+		void Execute();
+
+		std::vector<napi_value> GetResult(Napi::Env env);
+		
+	private:
+		std::string m_Error;
+		DesktopDuplication* m_DeskDup;
+};
\ No newline at end of file
@@ -0,0 +1,1237 @@
+#include "pixelconvert.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXELCONVERT_SSE2
+#include <emmintrin.h>
+#endif
+
+#define ENCODE_LUT_SIZE 4096
+
+// fractional bits of the fixed point YUV coefficients
+#define YUV_SHIFT 15
+
+// rotations work on square tiles of this many pixels, which keeps both the source rows and the destination rows of a tile in L1
+#define ROTATE_TILE_SIZE 32
+
+uint32_t bytesPerPixel(PIXEL_FORMAT format) {
+	switch (format) {
+		case PIXEL_FORMAT_RGBA16F:
+			return 8;
+		case PIXEL_FORMAT_NV12:
+		case PIXEL_FORMAT_I420:
+			return 1; // luma plane only
+		default:
+			return 4;
+	}
+}
+
+const char* pixelFormatName(PIXEL_FORMAT format) {
+	switch (format) {
+		case PIXEL_FORMAT_BGRA8:
+			return "bgra8";
+		case PIXEL_FORMAT_RGBA8:
+			return "rgba8";
+		case PIXEL_FORMAT_RGB10A2:
+			return "rgb10a2";
+		case PIXEL_FORMAT_RGBA16F:
+			return "rgba16f";
+		case PIXEL_FORMAT_NV12:
+			return "nv12";
+		case PIXEL_FORMAT_I420:
+			return "i420";
+		default:
+			return "unknown";
+	}
+}
+
+const char* colorSpaceName(COLOR_SPACE colorSpace) {
+	switch (colorSpace) {
+		case COLOR_SPACE_SRGB:
+			return "srgb";
+		case COLOR_SPACE_SCRGB:
+			return "scrgb";
+		case COLOR_SPACE_PQ:
+			return "pq";
+		default:
+			return "unknown";
+	}
+}
+
+// maps linear values in [0, 1] to 8 bit sRGB
+static const uint8_t* srgbEncodeLut() {
+	static uint8_t lut[ENCODE_LUT_SIZE];
+	static bool initialized = [] {
+		for (int i = 0; i < ENCODE_LUT_SIZE; i++) {
+			double v = (double)i / (ENCODE_LUT_SIZE - 1);
+			double s = (v <= 0.0031308) ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+			lut[i] = (uint8_t)(s * 255.0 + 0.5);
+		}
+		return true;
+	}();
+	(void)initialized;
+
+	return lut;
+}
+
+// maps 10 bit PQ code values to absolute luminance divided by 10000 nits
+static const float* pqDecodeLut() {
+	static float lut[1024];
+	static bool initialized = [] {
+		const double m1 = 2610.0 / 16384.0;
+		const double m2 = 2523.0 / 4096.0 * 128.0;
+		const double c1 = 3424.0 / 4096.0;
+		const double c2 = 2413.0 / 4096.0 * 32.0;
+		const double c3 = 2392.0 / 4096.0 * 32.0;
+
+		for (int i = 0; i < 1024; i++) {
+			double e = std::pow(i / 1023.0, 1.0 / m2);
+			double num = e - c1;
+			if (num < 0) num = 0;
+			lut[i] = (float)std::pow(num / (c2 - c3 * e), 1.0 / m1);
+		}
+		return true;
+	}();
+	(void)initialized;
+
+	return lut;
+}
+
+typedef struct {
+	float scale; // multiplier to get from source units to units of SDR white
+	float white; // source value (after scaling) at which highlights become pure white, at least 1.0
+	float invHeadroom; // 1 / (white - 1), 0 if there is no headroom above SDR white
+} TONEMAP;
+
+static TONEMAP makeToneMap(const CONVERSION_PARAMS& params, float sourceUnitNits) {
+	TONEMAP tm;
+
+	float sdrWhite = (params.sdrWhiteLevel > 0) ? params.sdrWhiteLevel : 80.0f;
+
+	tm.scale = sourceUnitNits / sdrWhite;
+	tm.white = params.maxLuminance / sdrWhite;
+
+	if (tm.white <= 1.01f) {
+		// no headroom above SDR white, highlights are just clipped
+		tm.white = 1.0f;
+		tm.invHeadroom = 0;
+	} else {
+		tm.invHeadroom = 1.0f / (tm.white - 1.0f);
+	}
+
+	return tm;
+}
+
+// Pixels up to SDR white are passed through unchanged, so SDR white is encoded as full white.
+// Above that the pixel is scaled down until its brightest channel is 1.0 and then blended towards white,
+// in proportion to how far the brightest channel lies between SDR white and the white point.
+// This keeps the hue of highlights instead of clipping each channel on its own.
+static inline void toneMap(float& r, float& g, float& b, const TONEMAP& tm) {
+	// also catches NaN
+	r = (r > 0) ? ((r < tm.white) ? r : tm.white) : 0;
+	g = (g > 0) ? ((g < tm.white) ? g : tm.white) : 0;
+	b = (b > 0) ? ((b < tm.white) ? b : tm.white) : 0;
+
+	float m = (r > g) ? r : g;
+	if (b > m) m = b;
+
+	if (m <= 1.0f) return;
+
+	float inv = 1.0f / m;
+	float t = (m - 1.0f) * tm.invHeadroom;
+	if (t > 1.0f) t = 1.0f;
+
+	r *= inv;
+	g *= inv;
+	b *= inv;
+
+	r += (1.0f - r) * t;
+	g += (1.0f - g) * t;
+	b += (1.0f - b) * t;
+}
+
+static inline uint8_t encodeSrgb(float y, const uint8_t* lut) {
+	if (!(y > 0)) return lut[0];
+	if (y > 1.0f) y = 1.0f;
+	return lut[(int)(y * (ENCODE_LUT_SIZE - 1) + 0.5f)];
+}
+
+static inline uint8_t unorm8(float v) {
+	if (!(v > 0)) return 0;
+	if (v > 1.0f) return 255;
+	return (uint8_t)(v * 255.0f + 0.5f);
+}
+
+static inline float halfToFloat(uint16_t h) {
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t expmant = h & 0x7fff;
+	uint32_t bits;
+
+	if (expmant >= 0x7c00) { // inf or NaN
+		bits = sign | 0x7f800000 | ((expmant & 0x3ff) << 13);
+	} else if (expmant >= 0x0400) { // normal
+		bits = sign | ((expmant << 13) + ((127 - 15) << 23));
+	} else { // zero or subnormal
+		float f = (float)expmant * (1.0f / 16777216.0f); // 2^-24
+		std::memcpy(&bits, &f, sizeof(bits));
+		bits |= sign;
+	}
+
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+#ifdef PIXELCONVERT_SSE2
+
+// converts four halfs stored in the low 16 bits of each 32 bit lane
+static inline __m128 halfToFloat4(__m128i h) {
+	const __m128i maskNoSign = _mm_set1_epi32(0x7fff);
+	const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+	const __m128i wasInfNan = _mm_set1_epi32(0x7bff);
+	const __m128 expInfNan = _mm_castsi128_ps(_mm_set1_epi32(255 << 23));
+
+	__m128i expmant = _mm_and_si128(maskNoSign, h);
+	__m128i justsign = _mm_xor_si128(h, expmant);
+	__m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expmant, 13)), magic);
+	__m128 infnanexp = _mm_and_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(expmant, wasInfNan)), expInfNan);
+	__m128 sign = _mm_castsi128_ps(_mm_slli_epi32(justsign, 16));
+
+	return _mm_or_ps(scaled, _mm_or_ps(sign, infnanexp));
+}
+
+// tone maps four pixels at once, see toneMap
+static inline void toneMap4(__m128& r, __m128& g, __m128& b, const TONEMAP& tm) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 white = _mm_set1_ps(tm.white);
+
+	// NaN becomes 0
+	r = _mm_min_ps(_mm_max_ps(r, zero), white);
+	g = _mm_min_ps(_mm_max_ps(g, zero), white);
+	b = _mm_min_ps(_mm_max_ps(b, zero), white);
+
+	// pixels with m <= 1 get inv = 1 and t = 0, which leaves them unchanged
+	__m128 m = _mm_max_ps(_mm_max_ps(r, g), b);
+	__m128 inv = _mm_div_ps(one, _mm_max_ps(m, one));
+	__m128 t = _mm_min_ps(_mm_mul_ps(_mm_max_ps(_mm_sub_ps(m, one), zero), _mm_set1_ps(tm.invHeadroom)), one);
+
+	r = _mm_mul_ps(r, inv);
+	g = _mm_mul_ps(g, inv);
+	b = _mm_mul_ps(b, inv);
+
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_sub_ps(one, r), t));
+	g = _mm_add_ps(g, _mm_mul_ps(_mm_sub_ps(one, g), t));
+	b = _mm_add_ps(b, _mm_mul_ps(_mm_sub_ps(one, b), t));
+}
+
+// returns LUT indices for values in [0, 1], like the output of toneMap4
+static inline __m128i encodeIndex4Unclamped(__m128 y) {
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(ENCODE_LUT_SIZE - 1)), _mm_set1_ps(0.5f)));
+}
+
+static inline __m128i encodeIndex4(__m128 y) {
+	y = _mm_min_ps(_mm_max_ps(y, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(ENCODE_LUT_SIZE - 1)), _mm_set1_ps(0.5f)));
+}
+
+// swaps bytes 0 and 2 of four 32 bit pixels (BGRA <-> RGBA)
+static inline __m128i swapRB4(__m128i p) {
+	const __m128i maskGA = _mm_set1_epi32(0xff00ff00);
+	const __m128i maskB = _mm_set1_epi32(0xff);
+
+	__m128i ga = _mm_and_si128(p, maskGA);
+	__m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), maskB);
+	__m128i b = _mm_slli_epi32(_mm_and_si128(p, maskB), 16);
+
+	return _mm_or_si128(ga, _mm_or_si128(r, b));
+}
+
+static inline __m128i reverse4(__m128i p) {
+	return _mm_shuffle_epi32(p, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+static inline void transpose4(__m128i& r0, __m128i& r1, __m128i& r2, __m128i& r3) {
+	__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+	__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+	__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+	__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+	r0 = _mm_unpacklo_epi64(t0, t1);
+	r1 = _mm_unpackhi_epi64(t0, t1);
+	r2 = _mm_unpacklo_epi64(t2, t3);
+	r3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+#endif
+
+static inline uint32_t swapRB(uint32_t p) {
+	return (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+}
+
+static void convertRowBGRA8(const uint8_t* src, uint8_t* dst, uint32_t width) {
+	uint32_t x = 0;
+
+#ifdef PIXELCONVERT_SSE2
+	for (; x + 4 <= width; x += 4) {
+		__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), swapRB4(p));
+	}
+#endif
+
+	for (; x < width; x++) {
+		dst[x * 4 + 0] = src[x * 4 + 2];
+		dst[x * 4 + 1] = src[x * 4 + 1];
+		dst[x * 4 + 2] = src[x * 4 + 0];
+		dst[x * 4 + 3] = src[x * 4 + 3];
+	}
+}
+
+static void convertRowRGB10A2(const uint8_t* src, uint8_t* dst, uint32_t width) {
+	uint32_t x = 0;
+
+	// 10 bit to 8 bit: (v * 255 + 512) >> 10, which is within one step of exact rounding
+#ifdef PIXELCONVERT_SSE2
+	const __m128i mask10 = _mm_set1_epi32(0x3ff);
+	const __m128i round = _mm_set1_epi32(512);
+
+	for (; x + 4 <= width; x += 4) {
+		__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+
+		__m128i r = _mm_and_si128(p, mask10);
+		__m128i g = _mm_and_si128(_mm_srli_epi32(p, 10), mask10);
+		__m128i b = _mm_and_si128(_mm_srli_epi32(p, 20), mask10);
+		__m128i a = _mm_srli_epi32(p, 30);
+
+		r = _mm_srli_epi32(_mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(r, 8), r), round), 10);
+		g = _mm_srli_epi32(_mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(g, 8), g), round), 10);
+		b = _mm_srli_epi32(_mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(b, 8), b), round), 10);
+		a = _mm_add_epi32(_mm_slli_epi32(a, 6), _mm_add_epi32(_mm_slli_epi32(a, 4), _mm_add_epi32(_mm_slli_epi32(a, 2), a))); // a * 85
+
+		__m128i out = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), out);
+	}
+#endif
+
+	for (; x < width; x++) {
+		uint32_t p;
+		std::memcpy(&p, src + x * 4, sizeof(p));
+
+		dst[x * 4 + 0] = (uint8_t)(((p & 0x3ff) * 255 + 512) >> 10);
+		dst[x * 4 + 1] = (uint8_t)((((p >> 10) & 0x3ff) * 255 + 512) >> 10);
+		dst[x * 4 + 2] = (uint8_t)((((p >> 20) & 0x3ff) * 255 + 512) >> 10);
+		dst[x * 4 + 3] = (uint8_t)((p >> 30) * 85);
+	}
+}
+
+// linear BT.2020 to linear BT.709
+static const float BT2020_TO_BT709[9] = {
+	 1.6605f, -0.5876f, -0.0728f,
+	-0.1246f,  1.1329f, -0.0083f,
+	-0.0182f, -0.1006f,  1.1187f
+};
+
+static void convertRowPQ(const uint8_t* src, uint8_t* dst, uint32_t width, const TONEMAP& tm, const float* pqLut, const uint8_t* encodeLut) {
+	const float* m = BT2020_TO_BT709;
+	uint32_t x = 0;
+
+#ifdef PIXELCONVERT_SSE2
+	__m128 matrix[9];
+	for (int i = 0; i < 9; i++) {
+		matrix[i] = _mm_set1_ps(m[i] * tm.scale);
+	}
+
+	for (; x + 4 <= width; x += 4) {
+		uint32_t p[4];
+		std::memcpy(p, src + x * 4, sizeof(p));
+
+		__m128 r = _mm_setr_ps(pqLut[p[0] & 0x3ff], pqLut[p[1] & 0x3ff], pqLut[p[2] & 0x3ff], pqLut[p[3] & 0x3ff]);
+		__m128 g = _mm_setr_ps(pqLut[(p[0] >> 10) & 0x3ff], pqLut[(p[1] >> 10) & 0x3ff], pqLut[(p[2] >> 10) & 0x3ff], pqLut[(p[3] >> 10) & 0x3ff]);
+		__m128 b = _mm_setr_ps(pqLut[(p[0] >> 20) & 0x3ff], pqLut[(p[1] >> 20) & 0x3ff], pqLut[(p[2] >> 20) & 0x3ff], pqLut[(p[3] >> 20) & 0x3ff]);
+
+		__m128 r709 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, matrix[0]), _mm_mul_ps(g, matrix[1])), _mm_mul_ps(b, matrix[2]));
+		__m128 g709 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, matrix[3]), _mm_mul_ps(g, matrix[4])), _mm_mul_ps(b, matrix[5]));
+		__m128 b709 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, matrix[6]), _mm_mul_ps(g, matrix[7])), _mm_mul_ps(b, matrix[8]));
+
+		toneMap4(r709, g709, b709, tm);
+
+		alignas(16) int32_t ri[4], gi[4], bi[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(ri), encodeIndex4Unclamped(r709));
+		_mm_store_si128(reinterpret_cast<__m128i*>(gi), encodeIndex4Unclamped(g709));
+		_mm_store_si128(reinterpret_cast<__m128i*>(bi), encodeIndex4Unclamped(b709));
+
+		for (int i = 0; i < 4; i++) {
+			dst[(x + i) * 4 + 0] = encodeLut[ri[i]];
+			dst[(x + i) * 4 + 1] = encodeLut[gi[i]];
+			dst[(x + i) * 4 + 2] = encodeLut[bi[i]];
+			dst[(x + i) * 4 + 3] = (uint8_t)((p[i] >> 30) * 85);
+		}
+	}
+#endif
+
+	for (; x < width; x++) {
+		uint32_t p;
+		std::memcpy(&p, src + x * 4, sizeof(p));
+
+		float r = pqLut[p & 0x3ff] * tm.scale;
+		float g = pqLut[(p >> 10) & 0x3ff] * tm.scale;
+		float b = pqLut[(p >> 20) & 0x3ff] * tm.scale;
+
+		float r709 = r * m[0] + g * m[1] + b * m[2];
+		float g709 = r * m[3] + g * m[4] + b * m[5];
+		float b709 = r * m[6] + g * m[7] + b * m[8];
+
+		toneMap(r709, g709, b709, tm);
+
+		dst[x * 4 + 0] = encodeSrgb(r709, encodeLut);
+		dst[x * 4 + 1] = encodeSrgb(g709, encodeLut);
+		dst[x * 4 + 2] = encodeSrgb(b709, encodeLut);
+		dst[x * 4 + 3] = (uint8_t)((p >> 30) * 85);
+	}
+}
+
+// Pixels which stay below SDR white don't need any tone mapping, so each of their halfs maps to exactly one output byte
+// and the conversion collapses into a table lookup. The table is built with the vector kernels and cached per thread until the scale changes.
+static const uint8_t* halfEncodeLut(float lutScale, const uint8_t* encodeLut) {
+	static thread_local uint8_t lut[65536];
+	static thread_local float cachedScale;
+	static thread_local bool valid = false;
+
+	if (valid && cachedScale == lutScale) {
+		return lut;
+	}
+
+	uint32_t h = 0;
+
+#ifdef PIXELCONVERT_SSE2
+	const __m128 scale = _mm_set1_ps(lutScale);
+
+	for (; h < 65536; h += 4) {
+		alignas(16) int32_t idx[4];
+		__m128i halfs = _mm_setr_epi32(h, h + 1, h + 2, h + 3);
+
+		_mm_store_si128(reinterpret_cast<__m128i*>(idx), encodeIndex4(_mm_mul_ps(halfToFloat4(halfs), scale)));
+
+		lut[h + 0] = encodeLut[idx[0]];
+		lut[h + 1] = encodeLut[idx[1]];
+		lut[h + 2] = encodeLut[idx[2]];
+		lut[h + 3] = encodeLut[idx[3]];
+	}
+#endif
+
+	for (; h < 65536; h++) {
+		lut[h] = encodeSrgb(halfToFloat((uint16_t)h) * lutScale, encodeLut);
+	}
+
+	cachedScale = lutScale;
+	valid = true;
+
+	return lut;
+}
+
+// returns the largest positive half which is still at most 1.0 after scaling
+static uint16_t halfScaleLimit(float scale) {
+	uint32_t lo = 0;
+	uint32_t hi = 0x7c00; // infinity
+
+	while (hi - lo > 1) {
+		uint32_t mid = (lo + hi) / 2;
+
+		if (halfToFloat((uint16_t)mid) * scale <= 1.0f) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return (uint16_t)lo;
+}
+
+static const uint8_t* halfAlphaLut() {
+	static uint8_t lut[65536];
+	static bool initialized = [] {
+		for (uint32_t h = 0; h < 65536; h++) {
+			lut[h] = unorm8(halfToFloat((uint16_t)h));
+		}
+		return true;
+	}();
+	(void)initialized;
+
+	return lut;
+}
+
+static void convertRowRGBA16F(const uint8_t* src, uint8_t* dst, uint32_t width, const TONEMAP& tm, uint16_t halfLimit, const uint8_t* colorLut, const uint8_t* encodeLut, const uint8_t* alphaLut) {
+	uint32_t x = 0;
+
+#ifdef PIXELCONVERT_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(tm.scale);
+
+	// SSE2 only compares signed 16 bit values, flipping the sign bit turns that into an unsigned comparison
+	const __m128i signBit = _mm_set1_epi16((short)0x8000);
+	const __m128i limit = _mm_set1_epi16((short)(halfLimit ^ 0x8000));
+
+	for (; x + 4 <= width; x += 4) {
+		__m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 8));
+		__m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 8 + 16));
+
+		// planar halfs: r0 r1 r2 r3 g0 g1 g2 g3 and b0 b1 b2 b3 a0 a1 a2 a3
+		__m128i t0 = _mm_unpacklo_epi16(p0, p1);
+		__m128i t1 = _mm_unpackhi_epi16(p0, p1);
+		__m128i rg = _mm_unpacklo_epi16(t0, t1);
+		__m128i ba = _mm_unpackhi_epi16(t0, t1);
+
+		alignas(16) uint16_t h[16];
+		_mm_store_si128(reinterpret_cast<__m128i*>(h), rg);
+		_mm_store_si128(reinterpret_cast<__m128i*>(h + 8), ba);
+
+		// the byte mask of b0 to b3 is in the low 8 bits of the movemask
+		__m128i aboveRG = _mm_cmpgt_epi16(_mm_xor_si128(rg, signBit), limit);
+		__m128i aboveB = _mm_cmpgt_epi16(_mm_xor_si128(ba, signBit), limit);
+
+		if (_mm_movemask_epi8(aboveRG) == 0 && (_mm_movemask_epi8(aboveB) & 0xff) == 0) {
+			for (int i = 0; i < 4; i++) {
+				dst[(x + i) * 4 + 0] = colorLut[h[i]];
+				dst[(x + i) * 4 + 1] = colorLut[h[4 + i]];
+				dst[(x + i) * 4 + 2] = colorLut[h[8 + i]];
+			}
+		} else {
+			__m128 r = _mm_mul_ps(halfToFloat4(_mm_unpacklo_epi16(rg, zero)), scale);
+			__m128 g = _mm_mul_ps(halfToFloat4(_mm_unpackhi_epi16(rg, zero)), scale);
+			__m128 b = _mm_mul_ps(halfToFloat4(_mm_unpacklo_epi16(ba, zero)), scale);
+
+			toneMap4(r, g, b, tm);
+
+			alignas(16) int32_t ri[4], gi[4], bi[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(ri), encodeIndex4Unclamped(r));
+			_mm_store_si128(reinterpret_cast<__m128i*>(gi), encodeIndex4Unclamped(g));
+			_mm_store_si128(reinterpret_cast<__m128i*>(bi), encodeIndex4Unclamped(b));
+
+			for (int i = 0; i < 4; i++) {
+				dst[(x + i) * 4 + 0] = encodeLut[ri[i]];
+				dst[(x + i) * 4 + 1] = encodeLut[gi[i]];
+				dst[(x + i) * 4 + 2] = encodeLut[bi[i]];
+			}
+		}
+
+		for (int i = 0; i < 4; i++) {
+			dst[(x + i) * 4 + 3] = alphaLut[h[12 + i]];
+		}
+	}
+#endif
+
+	for (; x < width; x++) {
+		uint16_t h[4];
+		std::memcpy(h, src + x * 8, sizeof(h));
+
+		// negative values (and -0) are rare enough to take the slow path as well
+		if (h[0] <= halfLimit && h[1] <= halfLimit && h[2] <= halfLimit) {
+			dst[x * 4 + 0] = colorLut[h[0]];
+			dst[x * 4 + 1] = colorLut[h[1]];
+			dst[x * 4 + 2] = colorLut[h[2]];
+		} else {
+			float r = halfToFloat(h[0]) * tm.scale;
+			float g = halfToFloat(h[1]) * tm.scale;
+			float b = halfToFloat(h[2]) * tm.scale;
+
+			toneMap(r, g, b, tm);
+
+			dst[x * 4 + 0] = encodeSrgb(r, encodeLut);
+			dst[x * 4 + 1] = encodeSrgb(g, encodeLut);
+			dst[x * 4 + 2] = encodeSrgb(b, encodeLut);
+		}
+
+		dst[x * 4 + 3] = alphaLut[h[3]];
+	}
+}
+
+typedef struct {
+	PIXEL_FORMAT format;
+	COLOR_SPACE colorSpace;
+	TONEMAP tm;
+	const float* pqLut;
+	const uint8_t* encodeLut;
+	const uint8_t* colorLut;
+	const uint8_t* alphaLut;
+	uint16_t halfLimit; // halfs up to this value are below SDR white and can use colorLut
+} ROW_CONVERTER;
+
+// sets up everything a row conversion needs once per frame
+static ROW_CONVERTER makeRowConverter(const CONVERSION_PARAMS& params) {
+	ROW_CONVERTER conv;
+	std::memset(&conv, 0, sizeof(conv));
+
+	conv.format = params.format;
+	conv.colorSpace = params.colorSpace;
+
+	if (params.format == PIXEL_FORMAT_RGB10A2 && params.colorSpace == COLOR_SPACE_PQ) {
+		conv.tm = makeToneMap(params, 10000.0f);
+		conv.pqLut = pqDecodeLut();
+		conv.encodeLut = srgbEncodeLut();
+	} else if (params.format == PIXEL_FORMAT_RGBA16F) {
+		conv.tm = makeToneMap(params, 80.0f);
+		conv.encodeLut = srgbEncodeLut();
+		conv.colorLut = halfEncodeLut(conv.tm.scale, conv.encodeLut);
+		conv.alphaLut = halfAlphaLut();
+		conv.halfLimit = halfScaleLimit(conv.tm.scale);
+	}
+
+	return conv;
+}
+
+static void convertRow(const ROW_CONVERTER& conv, const uint8_t* src, uint8_t* dst, uint32_t width) {
+	switch (conv.format) {
+		case PIXEL_FORMAT_RGBA8:
+			std::memcpy(dst, src, (size_t)width * 4);
+			break;
+		case PIXEL_FORMAT_BGRA8:
+			convertRowBGRA8(src, dst, width);
+			break;
+		case PIXEL_FORMAT_RGB10A2:
+			if (conv.colorSpace == COLOR_SPACE_PQ) {
+				convertRowPQ(src, dst, width, conv.tm, conv.pqLut, conv.encodeLut);
+			} else {
+				convertRowRGB10A2(src, dst, width);
+			}
+			break;
+		case PIXEL_FORMAT_RGBA16F:
+			convertRowRGBA16F(src, dst, width, conv.tm, conv.halfLimit, conv.colorLut, conv.encodeLut, conv.alphaLut);
+			break;
+		default:
+			break;
+	}
+}
+
+// Writes source pixel (x, y) of a width x height image to its place in the rotated image.
+template<typename T>
+static inline void storeRotated(uint8_t* dst, size_t dstPitch, uint32_t x, uint32_t y, uint32_t width, uint32_t height, ROTATION rotation, T pixel) {
+	uint32_t dx, dy;
+
+	switch (rotation) {
+		case ROTATION_90:
+			dx = height - 1 - y;
+			dy = x;
+			break;
+		case ROTATION_180:
+			dx = width - 1 - x;
+			dy = height - 1 - y;
+			break;
+		case ROTATION_270:
+			dx = y;
+			dy = width - 1 - x;
+			break;
+		default:
+			dx = x;
+			dy = y;
+			break;
+	}
+
+	std::memcpy(dst + dy * dstPitch + (size_t)dx * sizeof(T), &pixel, sizeof(T));
+}
+
+// Rotates one tile of 32 bit pixels by 90 or 270 degrees, optionally swapping R and B on the way.
+// `src` points at the top left pixel of the tile, which is at (x0, y0) in the width x height source image.
+template<bool swizzle, ROTATION rotation>
+static void rotateTile32(const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, uint32_t x0, uint32_t y0, uint32_t tileWidth, uint32_t tileHeight, uint32_t width, uint32_t height) {
+	uint32_t blockWidth = 0;
+	uint32_t blockHeight = 0;
+
+#ifdef PIXELCONVERT_SSE2
+	blockWidth = tileWidth & ~3u;
+	blockHeight = tileHeight & ~3u;
+
+	for (uint32_t by = 0; by < blockHeight; by += 4) {
+		const uint8_t* row = src + by * srcPitch;
+
+		for (uint32_t bx = 0; bx < blockWidth; bx += 4) {
+			__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + bx * 4));
+			__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + srcPitch + bx * 4));
+			__m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 2 * srcPitch + bx * 4));
+			__m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 3 * srcPitch + bx * 4));
+
+			if (swizzle) {
+				r0 = swapRB4(r0);
+				r1 = swapRB4(r1);
+				r2 = swapRB4(r2);
+				r3 = swapRB4(r3);
+			}
+
+			// afterwards rN holds column x0 + bx + N, rows y0 + by to y0 + by + 3
+			transpose4(r0, r1, r2, r3);
+
+			uint32_t sx = x0 + bx;
+			uint32_t sy = y0 + by;
+
+			if (rotation == ROTATION_90) {
+				uint8_t* out = dst + sx * dstPitch + (size_t)(height - 4 - sy) * 4;
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), reverse4(r0));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + dstPitch), reverse4(r1));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * dstPitch), reverse4(r2));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 3 * dstPitch), reverse4(r3));
+			} else {
+				uint8_t* out = dst + (width - 1 - sx) * dstPitch + (size_t)sy * 4;
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), r0);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out - dstPitch), r1);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out - 2 * dstPitch), r2);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out - 3 * dstPitch), r3);
+			}
+		}
+	}
+#endif
+
+	// whatever did not fit into 4x4 blocks: the right edge of the block rows, then the remaining rows
+	for (uint32_t y = 0; y < tileHeight; y++) {
+		const uint8_t* row = src + y * srcPitch;
+
+		for (uint32_t x = (y < blockHeight) ? blockWidth : 0; x < tileWidth; x++) {
+			uint32_t p;
+			std::memcpy(&p, row + x * 4, sizeof(p));
+			storeRotated<uint32_t>(dst, dstPitch, x0 + x, y0 + y, width, height, rotation, swizzle ? swapRB(p) : p);
+		}
+	}
+}
+
+// Rotates one tile of 64 bit pixels by 90 or 270 degrees, see rotateTile32.
+template<ROTATION rotation>
+static void rotateTile64(const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, uint32_t x0, uint32_t y0, uint32_t tileWidth, uint32_t tileHeight, uint32_t width, uint32_t height) {
+	uint32_t blockWidth = 0;
+	uint32_t blockHeight = 0;
+
+#ifdef PIXELCONVERT_SSE2
+	blockWidth = tileWidth & ~1u;
+	blockHeight = tileHeight & ~1u;
+
+	for (uint32_t by = 0; by < blockHeight; by += 2) {
+		const uint8_t* row = src + by * srcPitch;
+
+		for (uint32_t bx = 0; bx < blockWidth; bx += 2) {
+			__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + bx * 8));
+			__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + srcPitch + bx * 8));
+
+			__m128i c0 = _mm_unpacklo_epi64(r0, r1);
+			__m128i c1 = _mm_unpackhi_epi64(r0, r1);
+
+			uint32_t sx = x0 + bx;
+			uint32_t sy = y0 + by;
+
+			if (rotation == ROTATION_90) {
+				uint8_t* out = dst + sx * dstPitch + (size_t)(height - 2 - sy) * 8;
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi32(c0, _MM_SHUFFLE(1, 0, 3, 2)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + dstPitch), _mm_shuffle_epi32(c1, _MM_SHUFFLE(1, 0, 3, 2)));
+			} else {
+				uint8_t* out = dst + (width - 1 - sx) * dstPitch + (size_t)sy * 8;
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), c0);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out - dstPitch), c1);
+			}
+		}
+	}
+#endif
+
+	for (uint32_t y = 0; y < tileHeight; y++) {
+		const uint8_t* row = src + y * srcPitch;
+
+		for (uint32_t x = (y < blockHeight) ? blockWidth : 0; x < tileWidth; x++) {
+			uint64_t p;
+			std::memcpy(&p, row + x * 8, sizeof(p));
+			storeRotated<uint64_t>(dst, dstPitch, x0 + x, y0 + y, width, height, rotation, p);
+		}
+	}
+}
+
+// Rotates a whole image of 32 bit pixels tile by tile. Without a converter the pixels are copied directly
+// (optionally swapping R and B), otherwise every tile is converted into an L1 sized scratch buffer first.
+// Each tile touches 32 source and 32 destination rows, so for frames that don't fit into the cache this is limited by
+// memory access rather than by the transposes: a 4K BGRA frame takes about 2.5 to 3 times as long as without rotation.
+template<bool swizzle, ROTATION rotation>
+static void rotateImage32(const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, uint32_t width, uint32_t height, const ROW_CONVERTER* conv) {
+	uint8_t scratch[ROTATE_TILE_SIZE * ROTATE_TILE_SIZE * 4];
+	size_t srcBpp = (conv != nullptr) ? bytesPerPixel(conv->format) : 4;
+
+	for (uint32_t ty = 0; ty < height; ty += ROTATE_TILE_SIZE) {
+		uint32_t th = (height - ty < ROTATE_TILE_SIZE) ? height - ty : ROTATE_TILE_SIZE;
+
+		for (uint32_t tx = 0; tx < width; tx += ROTATE_TILE_SIZE) {
+			uint32_t tw = (width - tx < ROTATE_TILE_SIZE) ? width - tx : ROTATE_TILE_SIZE;
+			const uint8_t* tile = src + ty * srcPitch + tx * srcBpp;
+
+#ifdef PIXELCONVERT_SSE2
+			// the rows a rotated tile is written to are far apart, so the hardware prefetcher doesn't pick them up,
+			// instead the cache lines of the next tile are requested while this one is rotated
+			uint32_t nx = tx + ROTATE_TILE_SIZE;
+			if (nx + ROTATE_TILE_SIZE <= width && th == ROTATE_TILE_SIZE) {
+				for (uint32_t i = 0; i < ROTATE_TILE_SIZE; i++) {
+					const uint8_t* line = (rotation == ROTATION_90)
+						? dst + (nx + i) * dstPitch + (size_t)(height - ROTATE_TILE_SIZE - ty) * 4
+						: dst + (width - 1 - nx - i) * dstPitch + (size_t)ty * 4;
+
+					_mm_prefetch(reinterpret_cast<const char*>(line), _MM_HINT_T0);
+					_mm_prefetch(reinterpret_cast<const char*>(line + 64), _MM_HINT_T0);
+				}
+			}
+#endif
+
+			if (conv != nullptr) {
+				for (uint32_t y = 0; y < th; y++) {
+					convertRow(*conv, tile + y * srcPitch, scratch + y * ROTATE_TILE_SIZE * 4, tw);
+				}
+				rotateTile32<false, rotation>(scratch, ROTATE_TILE_SIZE * 4, dst, dstPitch, tx, ty, tw, th, width, height);
+			} else {
+				rotateTile32<swizzle, rotation>(tile, srcPitch, dst, dstPitch, tx, ty, tw, th, width, height);
+			}
+		}
+	}
+}
+
+template<ROTATION rotation>
+static void rotateImage64(const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, uint32_t width, uint32_t height) {
+	for (uint32_t ty = 0; ty < height; ty += ROTATE_TILE_SIZE) {
+		uint32_t th = (height - ty < ROTATE_TILE_SIZE) ? height - ty : ROTATE_TILE_SIZE;
+
+		for (uint32_t tx = 0; tx < width; tx += ROTATE_TILE_SIZE) {
+			uint32_t tw = (width - tx < ROTATE_TILE_SIZE) ? width - tx : ROTATE_TILE_SIZE;
+
+			rotateTile64<rotation>(src + ty * srcPitch + (size_t)tx * 8, srcPitch, dst, dstPitch, tx, ty, tw, th, width, height);
+		}
+	}
+}
+
+// Copies a row of 32 bit pixels in reverse order, optionally swapping R and B on the way. Must not be used in place.
+template<bool swizzle>
+static void reverseRow32(const uint8_t* src, uint8_t* dst, uint32_t width) {
+	uint32_t x = 0;
+
+#ifdef PIXELCONVERT_SSE2
+	for (; x + 4 <= width; x += 4) {
+		__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+		if (swizzle) p = swapRB4(p);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (size_t)(width - 4 - x) * 4), reverse4(p));
+	}
+#endif
+
+	for (; x < width; x++) {
+		uint32_t p;
+		std::memcpy(&p, src + x * 4, sizeof(p));
+		if (swizzle) p = swapRB(p);
+		std::memcpy(dst + (size_t)(width - 1 - x) * 4, &p, sizeof(p));
+	}
+}
+
+static void reverseRow64(const uint8_t* src, uint8_t* dst, uint32_t width) {
+	uint32_t x = 0;
+
+#ifdef PIXELCONVERT_SSE2
+	for (; x + 2 <= width; x += 2) {
+		__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 8));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (size_t)(width - 2 - x) * 8), _mm_shuffle_epi32(p, _MM_SHUFFLE(1, 0, 3, 2)));
+	}
+#endif
+
+	for (; x < width; x++) {
+		std::memcpy(dst + (size_t)(width - 1 - x) * 8, src + x * 8, 8);
+	}
+}
+
+typedef struct {
+	int32_t yr, yg, yb;
+	int32_t ur, ug, ub;
+	int32_t vr, vg, vb;
+	int32_t yBias; // offset and rounding of Y, in fixed point
+	int32_t uvBias; // offset and rounding of the sum of four pixels
+} YUV_COEFFS;
+
+static YUV_COEFFS makeYuvCoeffs(const YUV_PARAMS& yuv) {
+	double kr = (yuv.matrix == YUV_MATRIX_BT601) ? 0.299 : 0.2126;
+	double kb = (yuv.matrix == YUV_MATRIX_BT601) ? 0.114 : 0.0722;
+
+	double yScale = yuv.fullRange ? 1.0 : 219.0 / 255.0;
+	double uvScale = yuv.fullRange ? 1.0 : 224.0 / 255.0;
+	double one = (double)(1 << YUV_SHIFT);
+
+	YUV_COEFFS c;
+
+	// green takes up the rounding error of the others, so white and gray map exactly to the top of the range and to 128
+	c.yr = (int32_t)std::lround(kr * yScale * one);
+	c.yb = (int32_t)std::lround(kb * yScale * one);
+	c.yg = (int32_t)std::lround(yScale * one) - c.yr - c.yb;
+
+	c.ub = (int32_t)std::lround(0.5 * uvScale * one);
+	c.ur = (int32_t)std::lround(-0.5 * kr / (1.0 - kb) * uvScale * one);
+	c.ug = -c.ub - c.ur;
+
+	c.vr = (int32_t)std::lround(0.5 * uvScale * one);
+	c.vb = (int32_t)std::lround(-0.5 * kb / (1.0 - kr) * uvScale * one);
+	c.vg = -c.vr - c.vb;
+
+	c.yBias = ((yuv.fullRange ? 0 : 16) << YUV_SHIFT) + (1 << (YUV_SHIFT - 1));
+	c.uvBias = (128 << (YUV_SHIFT + 2)) + (1 << (YUV_SHIFT + 1));
+
+	return c;
+}
+
+static inline uint8_t clampByte(int32_t v) {
+	return (uint8_t)((v < 0) ? 0 : (v > 255) ? 255 : v);
+}
+
+// Converts two rows of RGBA or BGRA pixels (bgr) to two rows of Y and one row of UV.
+// `y1` is null for the last row of images with an odd height, `row1` then points to the same row as `row0`.
+template<bool bgr, YUV_LAYOUT layout>
+static void yuvRowPair(const uint8_t* row0, const uint8_t* row1, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, uint32_t width, const YUV_COEFFS& c) {
+	const int ri = bgr ? 2 : 0;
+	const int bi = bgr ? 0 : 2;
+	uint32_t x = 0;
+
+#ifdef PIXELCONVERT_SSE2
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i zero = _mm_setzero_si128();
+
+	// madd pairs up R with G and B with zero
+	auto coeffPair = [](int32_t lo, int32_t hi) {
+		return _mm_set1_epi32((int32_t)(((uint32_t)hi << 16) | ((uint32_t)lo & 0xFFFF)));
+	};
+
+	const __m128i yRG = coeffPair(c.yr, c.yg);
+	const __m128i yB = coeffPair(c.yb, 0);
+	const __m128i uRG = coeffPair(c.ur, c.ug);
+	const __m128i uB = coeffPair(c.ub, 0);
+	const __m128i vRG = coeffPair(c.vr, c.vg);
+	const __m128i vB = coeffPair(c.vb, 0);
+	const __m128i yBias = _mm_set1_epi32(c.yBias);
+	const __m128i uvBias = _mm_set1_epi32(c.uvBias);
+
+	// splits 8 pixels into 16 bit R, G and B
+	auto unpackChannels = [&](const uint8_t* p, __m128i& r, __m128i& g, __m128i& b) {
+		__m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+
+		__m128i c0 = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+		g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+		__m128i c2 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+
+		r = bgr ? c2 : c0;
+		b = bgr ? c0 : c2;
+	};
+
+	// 8 x 16 bit weighted sums of R, G and B, shifted right by `shift`
+	auto weightedSum = [&](__m128i r, __m128i g, __m128i b, __m128i cRG, __m128i cB, __m128i bias, int shift) {
+		__m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r, g), cRG), _mm_madd_epi16(_mm_unpacklo_epi16(b, zero), cB));
+		__m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r, g), cRG), _mm_madd_epi16(_mm_unpackhi_epi16(b, zero), cB));
+
+		lo = _mm_sra_epi32(_mm_add_epi32(lo, bias), _mm_cvtsi32_si128(shift));
+		hi = _mm_sra_epi32(_mm_add_epi32(hi, bias), _mm_cvtsi32_si128(shift));
+
+		return _mm_packs_epi32(lo, hi);
+	};
+
+	// adds up horizontal pairs of two vectors of 8 values
+	auto pairSums = [&](__m128i a, __m128i b) {
+		return _mm_packs_epi32(_mm_madd_epi16(a, ones), _mm_madd_epi16(b, ones));
+	};
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i r0a, g0a, b0a, r0b, g0b, b0b, r1a, g1a, b1a, r1b, g1b, b1b;
+
+		unpackChannels(row0 + x * 4, r0a, g0a, b0a);
+		unpackChannels(row0 + x * 4 + 32, r0b, g0b, b0b);
+		unpackChannels(row1 + x * 4, r1a, g1a, b1a);
+		unpackChannels(row1 + x * 4 + 32, r1b, g1b, b1b);
+
+		__m128i ya = weightedSum(r0a, g0a, b0a, yRG, yB, yBias, YUV_SHIFT);
+		__m128i yb = weightedSum(r0b, g0b, b0b, yRG, yB, yBias, YUV_SHIFT);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(y0 + x), _mm_packus_epi16(ya, yb));
+
+		if (y1) {
+			ya = weightedSum(r1a, g1a, b1a, yRG, yB, yBias, YUV_SHIFT);
+			yb = weightedSum(r1b, g1b, b1b, yRG, yB, yBias, YUV_SHIFT);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(y1 + x), _mm_packus_epi16(ya, yb));
+		}
+
+		// sums of 2x2 blocks, at most 4 * 255 so they still fit into 16 bits
+		__m128i rs = pairSums(_mm_add_epi16(r0a, r1a), _mm_add_epi16(r0b, r1b));
+		__m128i gs = pairSums(_mm_add_epi16(g0a, g1a), _mm_add_epi16(g0b, g1b));
+		__m128i bs = pairSums(_mm_add_epi16(b0a, b1a), _mm_add_epi16(b0b, b1b));
+
+		__m128i u8 = _mm_packus_epi16(weightedSum(rs, gs, bs, uRG, uB, uvBias, YUV_SHIFT + 2), zero);
+		__m128i v8 = _mm_packus_epi16(weightedSum(rs, gs, bs, vRG, vB, uvBias, YUV_SHIFT + 2), zero);
+
+		if (layout == YUV_LAYOUT_NV12) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(u + x), _mm_unpacklo_epi8(u8, v8));
+		} else {
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(u + x / 2), u8);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(v + x / 2), v8);
+		}
+	}
+#endif
+
+	for (; x < width; x += 2) {
+		// the last column of an odd width is used twice
+		uint32_t x1 = (x + 1 < width) ? x + 1 : x;
+
+		const uint8_t* p00 = row0 + x * 4;
+		const uint8_t* p01 = row0 + x1 * 4;
+		const uint8_t* p10 = row1 + x * 4;
+		const uint8_t* p11 = row1 + x1 * 4;
+
+		y0[x] = clampByte((c.yr * p00[ri] + c.yg * p00[1] + c.yb * p00[bi] + c.yBias) >> YUV_SHIFT);
+		if (x1 != x) {
+			y0[x1] = clampByte((c.yr * p01[ri] + c.yg * p01[1] + c.yb * p01[bi] + c.yBias) >> YUV_SHIFT);
+		}
+
+		if (y1) {
+			y1[x] = clampByte((c.yr * p10[ri] + c.yg * p10[1] + c.yb * p10[bi] + c.yBias) >> YUV_SHIFT);
+			if (x1 != x) {
+				y1[x1] = clampByte((c.yr * p11[ri] + c.yg * p11[1] + c.yb * p11[bi] + c.yBias) >> YUV_SHIFT);
+			}
+		}
+
+		int32_t rs = p00[ri] + p01[ri] + p10[ri] + p11[ri];
+		int32_t gs = p00[1] + p01[1] + p10[1] + p11[1];
+		int32_t bs = p00[bi] + p01[bi] + p10[bi] + p11[bi];
+
+		uint8_t us = clampByte((c.ur * rs + c.ug * gs + c.ub * bs + c.uvBias) >> (YUV_SHIFT + 2));
+		uint8_t vs = clampByte((c.vr * rs + c.vg * gs + c.vb * bs + c.uvBias) >> (YUV_SHIFT + 2));
+
+		if (layout == YUV_LAYOUT_NV12) {
+			u[x] = us;
+			u[x + 1] = vs;
+		} else {
+			u[x / 2] = us;
+			v[x / 2] = vs;
+		}
+	}
+}
+
+typedef void (*YUV_ROW_PAIR_FN)(const uint8_t*, const uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint32_t, const YUV_COEFFS&);
+
+// convertToRGBA8 with a converter that was already set up, so it can be called for parts of a frame
+static void convertRotated(const ROW_CONVERTER& conv, const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, uint32_t width, uint32_t height, ROTATION rotation) {
+	size_t srcBpp = bytesPerPixel(conv.format);
+
+	// BGRA and RGBA sources are swizzled inside the rotation kernels, everything else is converted in tiles first
+	bool direct = (conv.format == PIXEL_FORMAT_BGRA8 || conv.format == PIXEL_FORMAT_RGBA8);
+	bool swizzle = (conv.format == PIXEL_FORMAT_BGRA8);
+	const ROW_CONVERTER* tileConv = direct ? nullptr : &conv;
+
+	switch (rotation) {
+		case ROTATION_90:
+			if (swizzle) {
+				rotateImage32<true, ROTATION_90>(src, srcPitch, dst, dstPitch, width, height, tileConv);
+			} else {
+				rotateImage32<false, ROTATION_90>(src, srcPitch, dst, dstPitch, width, height, tileConv);
+			}
+			break;
+		case ROTATION_270:
+			if (swizzle) {
+				rotateImage32<true, ROTATION_270>(src, srcPitch, dst, dstPitch, width, height, tileConv);
+			} else {
+				rotateImage32<false, ROTATION_270>(src, srcPitch, dst, dstPitch, width, height, tileConv);
+			}
+			break;
+		case ROTATION_180: {
+			uint8_t scratch[ROTATE_TILE_SIZE * 4];
+
+			for (uint32_t y = 0; y < height; y++) {
+				const uint8_t* srcRow = src + y * srcPitch;
+				uint8_t* dstRow = dst + (height - 1 - y) * dstPitch;
+
+				if (swizzle) {
+					reverseRow32<true>(srcRow, dstRow, width);
+				} else if (direct) {
+					reverseRow32<false>(srcRow, dstRow, width);
+				} else {
+					for (uint32_t x = 0; x < width; x += ROTATE_TILE_SIZE) {
+						uint32_t w = (width - x < ROTATE_TILE_SIZE) ? width - x : ROTATE_TILE_SIZE;
+
+						convertRow(conv, srcRow + x * srcBpp, scratch, w);
+						reverseRow32<false>(scratch, dstRow + (size_t)(width - x - w) * 4, w);
+					}
+				}
+			}
+			break;
+		}
+		default:
+			for (uint32_t y = 0; y < height; y++) {
+				convertRow(conv, src + y * srcPitch, dst + y * dstPitch, width);
+			}
+			break;
+	}
+}
+
+void convertToRGBA8(const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, uint32_t width, uint32_t height, const CONVERSION_PARAMS& params) {
+	ROW_CONVERTER conv = makeRowConverter(params);
+	convertRotated(conv, src, srcPitch, dst, dstPitch, width, height, params.rotation);
+}
+
+void copyRotated(const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, uint32_t width, uint32_t height, uint32_t pixelSize, ROTATION rotation) {
+	switch (rotation) {
+		case ROTATION_90:
+			if (pixelSize == 8) {
+				rotateImage64<ROTATION_90>(src, srcPitch, dst, dstPitch, width, height);
+			} else {
+				rotateImage32<false, ROTATION_90>(src, srcPitch, dst, dstPitch, width, height, nullptr);
+			}
+			break;
+		case ROTATION_270:
+			if (pixelSize == 8) {
+				rotateImage64<ROTATION_270>(src, srcPitch, dst, dstPitch, width, height);
+			} else {
+				rotateImage32<false, ROTATION_270>(src, srcPitch, dst, dstPitch, width, height, nullptr);
+			}
+			break;
+		case ROTATION_180:
+			for (uint32_t y = 0; y < height; y++) {
+				const uint8_t* srcRow = src + y * srcPitch;
+				uint8_t* dstRow = dst + (height - 1 - y) * dstPitch;
+
+				if (pixelSize == 8) {
+					reverseRow64(srcRow, dstRow, width);
+				} else {
+					reverseRow32<false>(srcRow, dstRow, width);
+				}
+			}
+			break;
+		default:
+			copyRows(src, srcPitch, dst, dstPitch, (size_t)width * pixelSize, height);
+			break;
+	}
+}
+
+size_t yuvPlaneLayout(YUV_LAYOUT layout, uint32_t width, uint32_t height, PLANE_LAYOUT* planes, uint32_t* planeCount) {
+	size_t chromaWidth = (width + 1) / 2;
+	uint32_t chromaHeight = (height + 1) / 2;
+	size_t lumaSize = (size_t)width * height;
+
+	planes[0].offset = 0;
+	planes[0].pitch = width;
+	planes[0].height = height;
+
+	if (layout == YUV_LAYOUT_NV12) {
+		planes[1].offset = lumaSize;
+		planes[1].pitch = chromaWidth * 2;
+		planes[1].height = chromaHeight;
+
+		*planeCount = 2;
+		return lumaSize + chromaWidth * 2 * chromaHeight;
+	}
+
+	planes[1].offset = lumaSize;
+	planes[1].pitch = chromaWidth;
+	planes[1].height = chromaHeight;
+
+	planes[2].offset = lumaSize + chromaWidth * chromaHeight;
+	planes[2].pitch = chromaWidth;
+	planes[2].height = chromaHeight;
+
+	*planeCount = 3;
+	return lumaSize + chromaWidth * 2 * chromaHeight;
+}
+
+// Converts one pair of RGBA or BGRA rows to rows y and y + 1 of the YUV planes. For the last row of an odd height `row1` is ignored.
+static void storeYuvRowPair(YUV_ROW_PAIR_FN rowPair, const uint8_t* row0, const uint8_t* row1, uint8_t* dst, const PLANE_LAYOUT* planes, YUV_LAYOUT layout, uint32_t y, uint32_t width, uint32_t height, const YUV_COEFFS& c) {
+	bool lastOddRow = (y + 1 == height);
+
+	uint8_t* y0 = dst + planes[0].offset + y * planes[0].pitch;
+	uint8_t* y1 = lastOddRow ? nullptr : y0 + planes[0].pitch;
+	uint8_t* u = dst + planes[1].offset + (y / 2) * planes[1].pitch;
+	uint8_t* v = (layout == YUV_LAYOUT_I420) ? dst + planes[2].offset + (y / 2) * planes[2].pitch : nullptr;
+
+	rowPair(row0, lastOddRow ? row0 : row1, y0, y1, u, v, width, c);
+}
+
+static YUV_ROW_PAIR_FN selectYuvRowPair(YUV_LAYOUT layout, bool bgr) {
+	if (layout == YUV_LAYOUT_NV12) {
+		return bgr ? yuvRowPair<true, YUV_LAYOUT_NV12> : yuvRowPair<false, YUV_LAYOUT_NV12>;
+	}
+
+	return bgr ? yuvRowPair<true, YUV_LAYOUT_I420> : yuvRowPair<false, YUV_LAYOUT_I420>;
+}
+
+void convertToYUV420(const uint8_t* src, size_t srcPitch, uint8_t* dst, const PLANE_LAYOUT* planes, uint32_t width, uint32_t height, const CONVERSION_PARAMS& params, const YUV_PARAMS& yuv) {
+	YUV_COEFFS coeffs = makeYuvCoeffs(yuv);
+	ROW_CONVERTER conv = makeRowConverter(params);
+
+	// 4:2:0 needs two neighbouring rows of the rotated image at a time, so rotated frames are turned upright as RGBA
+	// one strip of ROTATE_TILE_SIZE rows at a time. The strip is the rotation of a narrow part of the source:
+	// a few columns for 90 and 270 degrees, a few rows for 180 degrees.
+	if (params.rotation != ROTATION_NONE) {
+		bool swapDimensions = (params.rotation == ROTATION_90 || params.rotation == ROTATION_270);
+		uint32_t rotatedWidth = swapDimensions ? height : width;
+		uint32_t rotatedHeight = swapDimensions ? width : height;
+
+		size_t srcBpp = bytesPerPixel(params.format);
+		size_t stripPitch = (size_t)rotatedWidth * 4;
+		std::vector<uint8_t> strip(stripPitch * ROTATE_TILE_SIZE);
+		YUV_ROW_PAIR_FN rowPair = selectYuvRowPair(yuv.layout, false);
+
+		for (uint32_t sy = 0; sy < rotatedHeight; sy += ROTATE_TILE_SIZE) {
+			uint32_t rows = (rotatedHeight - sy < ROTATE_TILE_SIZE) ? rotatedHeight - sy : ROTATE_TILE_SIZE;
+
+			switch (params.rotation) {
+				case ROTATION_90:
+					convertRotated(conv, src + sy * srcBpp, srcPitch, strip.data(), stripPitch, rows, height, ROTATION_90);
+					break;
+				case ROTATION_270:
+					convertRotated(conv, src + (width - sy - rows) * srcBpp, srcPitch, strip.data(), stripPitch, rows, height, ROTATION_270);
+					break;
+				default:
+					convertRotated(conv, src + (height - sy - rows) * srcPitch, srcPitch, strip.data(), stripPitch, width, rows, ROTATION_180);
+					break;
+			}
+
+			// ROTATE_TILE_SIZE is even, so row pairs never span two strips
+			for (uint32_t y = 0; y < rows; y += 2) {
+				const uint8_t* row0 = strip.data() + y * stripPitch;
+				storeYuvRowPair(rowPair, row0, row0 + stripPitch, dst, planes, yuv.layout, sy + y, rotatedWidth, rotatedHeight, coeffs);
+			}
+		}
+		return;
+	}
+
+	// BGRA and RGBA rows are read straight from the source, everything else is converted to RGBA one row pair at a time
+	bool direct = (params.format == PIXEL_FORMAT_BGRA8 || params.format == PIXEL_FORMAT_RGBA8);
+	bool bgr = (params.format == PIXEL_FORMAT_BGRA8);
+
+	std::vector<uint8_t> scratch;
+	if (!direct) {
+		scratch.resize((size_t)width * 4 * 2);
+	}
+
+	YUV_ROW_PAIR_FN rowPair = selectYuvRowPair(yuv.layout, bgr);
+
+	for (uint32_t y = 0; y < height; y += 2) {
+		bool lastOddRow = (y + 1 == height);
+
+		const uint8_t* row0 = src + y * srcPitch;
+		const uint8_t* row1 = lastOddRow ? row0 : row0 + srcPitch;
+
+		if (!direct) {
+			convertRow(conv, row0, scratch.data(), width);
+			row0 = scratch.data();
+
+			if (!lastOddRow) {
+				convertRow(conv, row1, scratch.data() + (size_t)width * 4, width);
+				row1 = scratch.data() + (size_t)width * 4;
+			}
+		}
+
+		storeYuvRowPair(rowPair, row0, row1, dst, planes, yuv.layout, y, width, height, coeffs);
+	}
+}
+
+void copyRows(const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, size_t rowBytes, uint32_t height) {
+	if (srcPitch == rowBytes && dstPitch == rowBytes) {
+		std::memcpy(dst, src, rowBytes * height);
+		return;
+	}
+
+	for (uint32_t y = 0; y < height; y++) {
+		std::memcpy(dst + y * dstPitch, src + y * srcPitch, rowBytes);
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+// The conversion kernels are kept free of any Windows/DirectX headers so they can be built and checked on any platform.
+
+#include <cstddef>
+#include <cstdint>
+
+enum PIXEL_FORMAT {
+	PIXEL_FORMAT_BGRA8,
+	PIXEL_FORMAT_RGBA8,
+	PIXEL_FORMAT_RGB10A2,
+	PIXEL_FORMAT_RGBA16F,
+	PIXEL_FORMAT_NV12, // output only
+	PIXEL_FORMAT_I420 // output only
+};
+
+enum COLOR_SPACE {
+	COLOR_SPACE_SRGB,
+	COLOR_SPACE_SCRGB, // linear, BT.709 primaries, 1.0 = 80 nits
+	COLOR_SPACE_PQ // SMPTE ST 2084, BT.2020 primaries
+};
+
+// clockwise
+enum ROTATION {
+	ROTATION_NONE,
+	ROTATION_90,
+	ROTATION_180,
+	ROTATION_270
+};
+
+enum YUV_MATRIX {
+	YUV_MATRIX_BT601,
+	YUV_MATRIX_BT709
+};
+
+// 4:2:0 layouts, NV12 stores U and V interleaved in a single plane, I420 in two separate planes
+enum YUV_LAYOUT {
+	YUV_LAYOUT_NV12,
+	YUV_LAYOUT_I420
+};
+
+typedef struct {
+	YUV_LAYOUT layout;
+	YUV_MATRIX matrix;
+	bool fullRange; // Y and UV in 0-255 instead of 16-235 and 16-240
+} YUV_PARAMS;
+
+typedef struct {
+	size_t offset; // byte offset of the plane from the start of the image
+	size_t pitch;
+	uint32_t height;
+} PLANE_LAYOUT;
+
+typedef struct {
+	PIXEL_FORMAT format;
+	COLOR_SPACE colorSpace;
+	ROTATION rotation;
+	float sdrWhiteLevel; // brightness of SDR white in nits, which is mapped to 1.0 in the output
+	float maxLuminance; // brightness in nits at which highlights are blended all the way to white, everything above is clipped
+} CONVERSION_PARAMS;
+
+uint32_t bytesPerPixel(PIXEL_FORMAT format);
+const char* pixelFormatName(PIXEL_FORMAT format);
+const char* colorSpaceName(COLOR_SPACE colorSpace);
+
+// Converts `height` rows of `width` pixels in the source format to RGBA8, tone mapping HDR content down to SDR.
+// The image is rotated at the same time, so for 90 and 270 degrees `dst` has to be `height` pixels wide and `width` pixels tall.
+void convertToRGBA8(const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, uint32_t width, uint32_t height, const CONVERSION_PARAMS& params);
+
+// Fills `planes` with a tightly packed layout for a width x height 4:2:0 image and returns the total size in bytes.
+// Odd widths and heights are rounded up for the chroma planes.
+size_t yuvPlaneLayout(YUV_LAYOUT layout, uint32_t width, uint32_t height, PLANE_LAYOUT* planes, uint32_t* planeCount);
+
+// Like convertToRGBA8, but converts to 4:2:0 YUV. Each UV sample is taken from the average of a 2x2 block of pixels.
+// `planes` has to describe the rotated image.
+void convertToYUV420(const uint8_t* src, size_t srcPitch, uint8_t* dst, const PLANE_LAYOUT* planes, uint32_t width, uint32_t height, const CONVERSION_PARAMS& params, const YUV_PARAMS& yuv);
+
+// Like copyRows, but rotates the image. `pixelSize` can be 4 or 8 bytes.
+void copyRotated(const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, uint32_t width, uint32_t height, uint32_t pixelSize, ROTATION rotation);
+
+// Copies `height` rows of `rowBytes` bytes without touching the pixel values.
+void copyRows(const uint8_t* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, size_t rowBytes, uint32_t height);
@@ -7,6 +7,8 @@
 #include <thread>
 #include <future>
 
+#include "pixelconvert.h"
+
 enum RESULT_TYPE {
 	RESULT_SUCCESS,
 	RESULT_ERROR,
@@ -14,10 +16,35 @@ enum RESULT_TYPE {
 	RESULT_ACCESSLOST
 };
 
+enum OUTPUT_FORMAT {
+	OUTPUT_RGBA8,
+	OUTPUT_NATIVE,
+	OUTPUT_NV12,
+	OUTPUT_I420
+};
+
+typedef struct {
+	bool hdr;
+	bool rotate;
+	OUTPUT_FORMAT outputFormat;
+	float sdrWhiteLevel;
+	float maxLuminance;
+	YUV_MATRIX yuvMatrix;
+	bool yuvFullRange;
+} CAPTURE_OPTIONS;
+
 typedef struct {
 	RESULT_TYPE result;
 	std::string error;
 	char* data;
+	size_t size;
 	UINT width;
 	UINT height;
+	PIXEL_FORMAT format;
+	PIXEL_FORMAT sourceFormat;
+	COLOR_SPACE sourceColorSpace;
+	ROTATION rotation;
+	uint32_t planeCount;
+	PLANE_LAYOUT planes[3];
+	double processingTime; // ms spent on copying and converting the frame
 } FRAME_DATA;
\ No newline at end of file
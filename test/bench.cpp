@@ -0,0 +1,161 @@
+#include "pixelconvert.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+// Throughput of the conversion kernels on a 4K frame, run with `make bench`.
+
+#define BENCH_WIDTH 3840
+#define BENCH_HEIGHT 2160
+#define BENCH_ITERATIONS 20
+
+static void bench(const char* name, const std::function<void()>& fn) {
+	fn(); // warm up caches and lookup tables
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < BENCH_ITERATIONS; i++) {
+		fn();
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / BENCH_ITERATIONS;
+
+	std::printf("%-32s %8.2f ms/frame %8.1f fps\n", name, ms, 1000.0 / ms);
+}
+
+// positive floats only, anything below the smallest normal half becomes 0
+static uint16_t floatToHalf(float f) {
+	if (!(f >= 6.104e-5f)) return 0;
+	if (f >= 65504.0f) return 0x7bff;
+
+	uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(bits));
+	bits += 0x1000; // round to nearest
+
+	return (uint16_t)((((bits >> 23) - 112) << 10) | ((bits >> 13) & 0x3ff));
+}
+
+// scRGB pixels where `highlights` of them have channels between `lo` and `hi` times SDR white, the rest stays below it
+static std::vector<uint8_t> scrgbFrame(uint32_t width, uint32_t height, double highlights, float lo, float hi, std::mt19937& rng) {
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<uint8_t> frame((size_t)width * height * 8);
+
+	for (size_t i = 0; i < (size_t)width * height; i++) {
+		bool highlight = unit(rng) < highlights;
+		uint16_t h[4];
+
+		for (int c = 0; c < 3; c++) {
+			h[c] = floatToHalf(highlight ? lo + (hi - lo) * unit(rng) : unit(rng));
+		}
+		h[3] = 0x3c00;
+
+		std::memcpy(&frame[i * 8], h, sizeof(h));
+	}
+
+	return frame;
+}
+
+// 10 bit PQ pixels with the same split, 498 is the code value of 80 nits
+static std::vector<uint8_t> pqFrame(uint32_t width, uint32_t height, double highlights, std::mt19937& rng) {
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<uint8_t> frame((size_t)width * height * 4);
+
+	for (size_t i = 0; i < (size_t)width * height; i++) {
+		bool highlight = unit(rng) < highlights;
+		uint32_t p = 3u << 30;
+
+		for (int c = 0; c < 3; c++) {
+			uint32_t code = highlight ? 498 + (uint32_t)(525 * unit(rng)) : (uint32_t)(498 * unit(rng));
+			p |= code << (c * 10);
+		}
+
+		std::memcpy(&frame[i * 4], &p, sizeof(p));
+	}
+
+	return frame;
+}
+
+int main() {
+	const uint32_t width = BENCH_WIDTH, height = BENCH_HEIGHT;
+	std::mt19937 rng(4);
+
+	// random values, but with halfs mostly below SDR white like regular desktop content
+	std::vector<uint8_t> src((size_t)width * height * 8);
+	for (auto& v : src) v = (uint8_t)(rng() & 0x3b);
+
+	// HDR content with 10% highlights, and a frame of nothing but highlights as the worst case
+	std::vector<uint8_t> scrgbMixed = scrgbFrame(width, height, 0.1, 1.0f, 12.5f, rng);
+	std::vector<uint8_t> scrgbBright = scrgbFrame(width, height, 1.0, 4.0f, 10.0f, rng);
+	std::vector<uint8_t> pqMixed = pqFrame(width, height, 0.1, rng);
+	std::vector<uint8_t> pqBright = pqFrame(width, height, 1.0, rng);
+
+	std::vector<uint8_t> dst((size_t)width * height * 8);
+
+	bench("memcpy (4 bytes/pixel)", [&] {
+		std::memcpy(dst.data(), src.data(), (size_t)width * height * 4);
+	});
+
+	struct { const char* name; PIXEL_FORMAT format; COLOR_SPACE colorSpace; const std::vector<uint8_t>& frame; } sources[] = {
+		{ "bgra8 -> rgba8", PIXEL_FORMAT_BGRA8, COLOR_SPACE_SRGB, src },
+		{ "rgb10a2 -> rgba8", PIXEL_FORMAT_RGB10A2, COLOR_SPACE_SRGB, src },
+		{ "rgb10a2 pq -> rgba8", PIXEL_FORMAT_RGB10A2, COLOR_SPACE_PQ, src },
+		{ "rgb10a2 pq 10% highlights", PIXEL_FORMAT_RGB10A2, COLOR_SPACE_PQ, pqMixed },
+		{ "rgb10a2 pq all highlights", PIXEL_FORMAT_RGB10A2, COLOR_SPACE_PQ, pqBright },
+		{ "rgba16f scrgb sdr -> rgba8", PIXEL_FORMAT_RGBA16F, COLOR_SPACE_SCRGB, src },
+		{ "rgba16f scrgb 10% highlights", PIXEL_FORMAT_RGBA16F, COLOR_SPACE_SCRGB, scrgbMixed },
+		{ "rgba16f scrgb all highlights", PIXEL_FORMAT_RGBA16F, COLOR_SPACE_SCRGB, scrgbBright },
+	};
+
+	for (auto& s : sources) {
+		CONVERSION_PARAMS params = { s.format, s.colorSpace, ROTATION_NONE, 80.0f, 1000.0f };
+		const uint8_t* frame = s.frame.data();
+
+		bench(s.name, [&] {
+			convertToRGBA8(frame, (size_t)width * bytesPerPixel(s.format), dst.data(), (size_t)width * 4, width, height, params);
+		});
+	}
+
+	// 0 degrees is the baseline for the rotated conversions
+	for (int r = ROTATION_NONE; r <= ROTATION_270; r++) {
+		char name[64];
+		std::snprintf(name, sizeof(name), "bgra8 -> rgba8 rotated %d", r * 90);
+
+		CONVERSION_PARAMS params = { PIXEL_FORMAT_BGRA8, COLOR_SPACE_SRGB, (ROTATION)r, 80.0f, 1000.0f };
+		size_t dstPitch = (size_t)((r == ROTATION_90 || r == ROTATION_270) ? height : width) * 4;
+
+		bench(name, [&] {
+			convertToRGBA8(src.data(), (size_t)width * 4, dst.data(), dstPitch, width, height, params);
+		});
+	}
+
+	for (int layout = YUV_LAYOUT_NV12; layout <= YUV_LAYOUT_I420; layout++) {
+		PLANE_LAYOUT planes[3];
+		uint32_t planeCount;
+		yuvPlaneLayout((YUV_LAYOUT)layout, width, height, planes, &planeCount);
+
+		CONVERSION_PARAMS params = { PIXEL_FORMAT_BGRA8, COLOR_SPACE_SRGB, ROTATION_NONE, 80.0f, 1000.0f };
+		YUV_PARAMS yuv = { (YUV_LAYOUT)layout, YUV_MATRIX_BT709, false };
+
+		bench((layout == YUV_LAYOUT_NV12) ? "bgra8 -> nv12" : "bgra8 -> i420", [&] {
+			convertToYUV420(src.data(), (size_t)width * 4, dst.data(), planes, width, height, params, yuv);
+		});
+	}
+
+	{
+		// the rotated image is converted in strips of ROTATE_TILE_SIZE rows
+		PLANE_LAYOUT planes[3];
+		uint32_t planeCount;
+		yuvPlaneLayout(YUV_LAYOUT_NV12, height, width, planes, &planeCount);
+
+		CONVERSION_PARAMS params = { PIXEL_FORMAT_BGRA8, COLOR_SPACE_SRGB, ROTATION_90, 80.0f, 1000.0f };
+		YUV_PARAMS yuv = { YUV_LAYOUT_NV12, YUV_MATRIX_BT709, false };
+
+		bench("bgra8 -> nv12 rotated 90", [&] {
+			convertToYUV420(src.data(), (size_t)width * 4, dst.data(), planes, width, height, params, yuv);
+		});
+	}
+
+	return 0;
+}
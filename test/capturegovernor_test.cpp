@@ -0,0 +1,187 @@
+#include "test.h"
+#include "capturegovernor.h"
+
+#include <cmath>
+#include <limits>
+
+// Drives runCaptureStep and the governor with a fake clock. The desktop is simulated by the time at which it changes next,
+// every call only advances the clock by the time the real call would have blocked.
+
+static const double NEVER = std::numeric_limits<double>::infinity();
+
+class FakeCaptureBackend : public CaptureLoopBackend {
+	public:
+		double clock = 0;
+		double nextChange = NEVER; // the desktop changes at this time
+		double changeDelay = -1; // if >= 0 the desktop changes again this many ms after each captured frame
+		double processingTime = 2;
+		uint32_t pending = 0;
+		bool dropFrames = false;
+		bool accessLost = false;
+		int stopAfterAcquires = -1;
+
+		// statistics of the last step
+		int acquires = 0;
+		uint32_t maxTimeout = 0;
+		double acquireTime = 0;
+		int delivered = 0;
+
+		void resetStep() {
+			acquires = 0;
+			maxTimeout = 0;
+			acquireTime = 0;
+			delivered = 0;
+		}
+
+		double now() {
+			return clock;
+		}
+
+		CAPTURE_OUTCOME acquireFrame(uint32_t timeout, double* frameTime) {
+			acquires++;
+			if (timeout > maxTimeout) maxTimeout = timeout;
+			if (accessLost) return CAPTURE_ACCESSLOST;
+
+			if (nextChange > clock + timeout) {
+				clock += timeout;
+				acquireTime += timeout;
+				return CAPTURE_TIMEOUT;
+			}
+
+			if (nextChange > clock) {
+				acquireTime += nextChange - clock;
+				clock = nextChange;
+			}
+
+			clock += processingTime;
+			*frameTime = processingTime;
+			nextChange = (changeDelay >= 0) ? clock + changeDelay : NEVER;
+			return CAPTURE_FRAME;
+		}
+
+		bool deliverFrame() {
+			delivered++;
+			return !dropFrames;
+		}
+
+		uint32_t pendingFrames() {
+			return pending;
+		}
+
+		bool wait(double duration) {
+			clock += duration;
+			return true;
+		}
+
+		bool stopRequested() {
+			return stopAfterAcquires >= 0 && acquires >= stopAfterAcquires;
+		}
+};
+
+static bool near(double a, double b) {
+	return std::fabs(a - b) < 1e-6;
+}
+
+// Runs up to `steps` iterations, stopping early once the interval and the reason match.
+static void runUntil(CaptureGovernor& governor, std::mutex& mutex, FakeCaptureBackend& backend, int steps, double interval, GOVERNOR_REASON reason) {
+	for (int i = 0; i < steps; i++) {
+		double before = governor.state().interval;
+		backend.resetStep();
+
+		double start = backend.clock;
+		CAPTURE_OUTCOME outcome = runCaptureStep(governor, mutex, backend);
+
+		CHECK(backend.maxTimeout <= ADAPTIVE_CAPTURE_MAX_TIMEOUT, "step %d: acquired with a timeout of %u ms", i, backend.maxTimeout);
+		if (outcome == CAPTURE_TIMEOUT) {
+			// an idle desktop is watched for the whole interval, not only for the first slice
+			CHECK(backend.acquireTime >= before - 1e-6, "step %d: waited %g ms for a change, interval was %g ms", i, backend.acquireTime, before);
+			CHECK(backend.delivered == 0, "step %d: delivered an unchanged frame", i);
+		}
+		CHECK(backend.clock - start >= governor.state().interval - 1e-6, "step %d: took %g ms, interval is %g ms", i, backend.clock - start, governor.state().interval);
+
+		if (near(governor.state().interval, interval) && governor.state().reason == reason) break;
+	}
+}
+
+int main() {
+	GOVERNOR_OPTIONS options;
+	options.minFps = 1;
+	options.maxFps = 50;
+	options.cpuBudget = 0.5;
+
+	CaptureGovernor governor(options);
+	std::mutex mutex;
+	FakeCaptureBackend backend;
+
+	CHECK(near(governor.state().interval, 20) && governor.state().reason == GOVERNOR_STARTUP, "starts at %g ms", governor.state().interval);
+
+	// idle: the interval grows to 1000 / minFps
+	runUntil(governor, mutex, backend, 100, 1000, GOVERNOR_IDLE);
+	CHECK(near(governor.state().interval, 1000), "idle: interval %g ms", governor.state().interval);
+	CHECK(governor.state().reason == GOVERNOR_IDLE, "idle: reason %s", CaptureGovernor::reasonName(governor.state().reason));
+
+	backend.resetStep();
+	runCaptureStep(governor, mutex, backend);
+	CHECK(backend.acquires == 10 && backend.maxTimeout == ADAPTIVE_CAPTURE_MAX_TIMEOUT, "idle: %d acquires for 1000 ms", backend.acquires);
+
+	// burst: a change 250 ms into the interval is picked up in the slice it happens in
+	backend.nextChange = backend.clock + 250;
+	backend.changeDelay = 5;
+	backend.resetStep();
+	double start = backend.clock;
+	CHECK(runCaptureStep(governor, mutex, backend) == CAPTURE_FRAME, "burst: no frame");
+	CHECK(backend.acquires == 3 && near(backend.acquireTime, 250) && backend.delivered == 1, "burst: %d acquires, %g ms", backend.acquires, backend.acquireTime);
+	CHECK(governor.state().reason == GOVERNOR_CHANGING && near(governor.state().interval, 250), "burst: interval %g ms", governor.state().interval);
+	CHECK(near(backend.clock - start, 250 + backend.processingTime), "burst: step took %g ms", backend.clock - start);
+
+	runUntil(governor, mutex, backend, 20, 20, GOVERNOR_CHANGING);
+	CHECK(near(governor.state().interval, 20), "burst: interval %g ms", governor.state().interval);
+	CHECK(governor.state().reason == GOVERNOR_CHANGING, "burst: reason %s", CaptureGovernor::reasonName(governor.state().reason));
+	for (int i = 0; i < 30; i++) {
+		runCaptureStep(governor, mutex, backend);
+	}
+	CHECK(std::fabs(governor.state().fps - 50) < 1, "burst: %g fps", governor.state().fps);
+
+	// consumer lag: frames still waiting in JS double the interval
+	backend.pending = 1;
+	runCaptureStep(governor, mutex, backend);
+	CHECK(near(governor.state().interval, 40), "lag: interval %g ms", governor.state().interval);
+	CHECK(governor.state().reason == GOVERNOR_CONSUMER_LAG, "lag: reason %s", CaptureGovernor::reasonName(governor.state().reason));
+	CHECK(governor.state().pendingFrames == 1, "lag: %u pending frames", governor.state().pendingFrames);
+
+	backend.pending = 0;
+	backend.dropFrames = true;
+	runCaptureStep(governor, mutex, backend);
+	CHECK(near(governor.state().interval, 80) && governor.state().reason == GOVERNOR_CONSUMER_LAG, "drop: interval %g ms", governor.state().interval);
+	CHECK(governor.state().droppedFrames == 1, "drop: %llu dropped frames", (unsigned long long)governor.state().droppedFrames);
+
+	backend.dropFrames = false;
+	runUntil(governor, mutex, backend, 20, 20, GOVERNOR_CHANGING);
+	CHECK(near(governor.state().interval, 20), "recovery: interval %g ms", governor.state().interval);
+
+	// cpu budget: 30 ms per frame with half a core allowed settles at 60 ms
+	backend.processingTime = 30;
+	for (int i = 0; i < 60; i++) {
+		runCaptureStep(governor, mutex, backend);
+	}
+	CHECK(std::fabs(governor.state().interval - 60) < 0.5, "budget: interval %g ms", governor.state().interval);
+	CHECK(governor.state().reason == GOVERNOR_CPU_BUDGET, "budget: reason %s", CaptureGovernor::reasonName(governor.state().reason));
+
+	// a lost duplication is handed back to the caller without touching the governor
+	GOVERNOR_STATE before = governor.state();
+	backend.accessLost = true;
+	CHECK(runCaptureStep(governor, mutex, backend) == CAPTURE_ACCESSLOST, "access lost not returned");
+	CHECK(near(governor.state().interval, before.interval) && governor.state().reason == before.reason, "access lost changed the governor");
+	backend.accessLost = false;
+
+	// a stop request ends the wait for a change after the current slice
+	backend.changeDelay = -1;
+	backend.nextChange = NEVER;
+	backend.processingTime = 2;
+	runUntil(governor, mutex, backend, 100, 1000, GOVERNOR_IDLE);
+	backend.resetStep();
+	backend.stopAfterAcquires = 1;
+	CHECK(runCaptureStep(governor, mutex, backend) == CAPTURE_TIMEOUT && backend.acquires == 1, "stop: %d acquires", backend.acquires);
+
+	return testResult("capturegovernor");
+}
@@ -0,0 +1,178 @@
+#include "test.h"
+#include "devicecache.h"
+
+#include <deque>
+#include <vector>
+
+// Drives the device cache and DuplicationSession with a mock backend, which counts the references to its devices
+// and lets every call fail the way D3D would after a driver update or a display mode change.
+
+typedef struct {
+	int id;
+	int refs;
+	bool removed;
+} MOCK_DEVICE;
+
+// the devices of the process, shared by the backends of all instances
+class MockGpu {
+	public:
+		std::vector<MOCK_DEVICE*> devices;
+		bool failCreate = false;
+
+		~MockGpu() {
+			for (MOCK_DEVICE* device : devices) {
+				delete device;
+			}
+		}
+};
+
+class MockBackend : public DeviceBackend {
+	public:
+		MockGpu& gpu;
+		MOCK_DEVICE* duplicatedOn = nullptr;
+		int duplications = 0;
+		std::deque<BACKEND_RESULT> duplicateResults; // scripted results for the next calls of duplicateOutput
+
+		MockBackend(MockGpu& gpu) : gpu(gpu) {}
+
+		BACKEND_RESULT createDevice(DEVICE_HANDLE* device, std::string& error) {
+			if (gpu.failCreate) {
+				error = "no adapter";
+				return BACKEND_ERROR;
+			}
+
+			MOCK_DEVICE* created = new MOCK_DEVICE{ (int)gpu.devices.size() + 1, 1, false };
+			gpu.devices.push_back(created);
+			*device = created;
+			return BACKEND_OK;
+		}
+
+		void retainDevice(DEVICE_HANDLE device) {
+			static_cast<MOCK_DEVICE*>(device)->refs++;
+		}
+
+		void releaseDevice(DEVICE_HANDLE device) {
+			MOCK_DEVICE* released = static_cast<MOCK_DEVICE*>(device);
+			CHECK(released->refs > 0, "device %d released too often", released->id);
+			released->refs--;
+		}
+
+		BACKEND_RESULT deviceStatus(DEVICE_HANDLE device) {
+			return static_cast<MOCK_DEVICE*>(device)->removed ? BACKEND_DEVICE_REMOVED : BACKEND_OK;
+		}
+
+		BACKEND_RESULT duplicateOutput(DEVICE_HANDLE device, std::string& error) {
+			MOCK_DEVICE* target = static_cast<MOCK_DEVICE*>(device);
+			duplications++;
+			CHECK(duplicatedOn == nullptr, "duplicated on device %d without releasing the previous duplication", target->id);
+			CHECK(target->refs > 0, "duplicated on released device %d", target->id);
+
+			BACKEND_RESULT result = target->removed ? BACKEND_DEVICE_REMOVED : BACKEND_OK;
+			if (!duplicateResults.empty()) {
+				result = duplicateResults.front();
+				duplicateResults.pop_front();
+
+				// the device can also disappear between the status check and the duplication
+				if (result == BACKEND_DEVICE_REMOVED) {
+					target->removed = true;
+				}
+			}
+
+			if (result != BACKEND_OK) {
+				error = "duplication failed";
+				return result;
+			}
+
+			duplicatedOn = target;
+			return BACKEND_OK;
+		}
+
+		void releaseDuplication() {
+			duplicatedOn = nullptr;
+		}
+};
+
+static MOCK_DEVICE* deviceOf(DuplicationSession& session) {
+	return static_cast<MOCK_DEVICE*>(session.device());
+}
+
+int main() {
+	MockGpu gpu;
+	DeviceCache cache;
+
+	MockBackend backendA(gpu), backendB(gpu);
+	DuplicationSession sessionA(cache, backendA), sessionB(cache, backendB);
+
+	// all instances share the device, which is only created once
+	CHECK(sessionA.initialize() == "" && sessionB.initialize() == "", "initialize failed");
+	CHECK(gpu.devices.size() == 1, "reuse: %d devices created", (int)gpu.devices.size());
+	MOCK_DEVICE* first = gpu.devices[0];
+	CHECK(deviceOf(sessionA) == first && deviceOf(sessionB) == first, "reuse: instances use different devices");
+	CHECK(backendA.duplicatedOn == first && backendB.duplicatedOn == first, "reuse: not duplicated on the shared device");
+	CHECK(first->refs == 3, "reuse: %d references, expected one for the cache and one per instance", first->refs);
+
+	// initializing again releases the previous duplication and device reference
+	CHECK(sessionA.initialize() == "", "initialize again failed");
+	CHECK(gpu.devices.size() == 1 && first->refs == 3, "initialize again: %d devices, %d references", (int)gpu.devices.size(), first->refs);
+
+	// fast path: the device survived, so only the duplication is created again
+	int duplications = backendA.duplications;
+	CHECK(sessionA.reinitialize() == "", "fast path failed");
+	CHECK(backendA.duplications == duplications + 1 && gpu.devices.size() == 1 && deviceOf(sessionA) == first, "fast path did not reuse the device");
+	CHECK(first->refs == 3, "fast path: %d references", first->refs);
+
+	// a removed device is replaced by a new one, which the other instances pick up when they reinitialize
+	first->removed = true;
+	CHECK(sessionA.reinitialize() == "", "reinitialize after device removal failed");
+	CHECK(gpu.devices.size() == 2, "removal: %d devices created", (int)gpu.devices.size());
+	MOCK_DEVICE* second = gpu.devices[1];
+	CHECK(deviceOf(sessionA) == second && backendA.duplicatedOn == second, "removal: not moved to the new device");
+	CHECK(first->refs == 1, "removal: old device has %d references, expected one for the instance still using it", first->refs);
+
+	CHECK(sessionB.reinitialize() == "", "second instance failed to reinitialize");
+	CHECK(gpu.devices.size() == 2 && deviceOf(sessionB) == second, "removal: second instance did not reuse the new device");
+	CHECK(first->refs == 0 && second->refs == 3, "removal: %d and %d references", first->refs, second->refs);
+
+	// the device is removed while the duplication is created again, so the fast path falls back to a full initialization
+	backendA.duplicateResults.push_back(BACKEND_DEVICE_REMOVED);
+	duplications = backendA.duplications;
+	CHECK(sessionA.reinitialize() == "", "fallback after device removal failed");
+	CHECK(gpu.devices.size() == 3 && deviceOf(sessionA) == gpu.devices[2], "fallback: no new device after removal");
+	CHECK(backendA.duplications == duplications + 2, "fallback: %d duplications", backendA.duplications - duplications);
+	CHECK(second->refs == 1, "fallback: old device has %d references", second->refs);
+	CHECK(sessionB.reinitialize() == "" && second->refs == 0, "fallback: second instance kept the removed device");
+	MOCK_DEVICE* third = gpu.devices[2];
+
+	// any other failure of the fast path also falls back, but keeps the cached device
+	backendA.duplicateResults.push_back(BACKEND_ERROR);
+	CHECK(sessionA.reinitialize() == "", "fallback after an error failed");
+	CHECK(gpu.devices.size() == 3 && deviceOf(sessionA) == third && third->refs == 3, "fallback after an error: %d devices, %d references", (int)gpu.devices.size(), third->refs);
+
+	// while the output can't be duplicated, a new device would not help, so the device is kept for the next attempt
+	backendA.duplicateResults.push_back(BACKEND_ACCESSLOST);
+	duplications = backendA.duplications;
+	CHECK(sessionA.reinitialize() != "", "access lost: reinitialize succeeded");
+	CHECK(backendA.duplications == duplications + 1 && backendA.duplicatedOn == nullptr, "access lost: %d duplications", backendA.duplications - duplications);
+	CHECK(gpu.devices.size() == 3 && deviceOf(sessionA) == third && third->refs == 3, "access lost: device not kept");
+	CHECK(sessionA.reinitialize() == "" && backendA.duplicatedOn == third, "access lost: next attempt failed");
+
+	// a failed initialization doesn't leak any references
+	backendB.duplicateResults.push_back(BACKEND_ERROR);
+	CHECK(sessionB.initialize() == "duplication failed", "failed duplication not reported");
+	CHECK(deviceOf(sessionB) == nullptr && backendB.duplicatedOn == nullptr && third->refs == 2, "failed duplication: %d references", third->refs);
+
+	third->removed = true;
+	gpu.failCreate = true;
+	CHECK(sessionB.initialize() == "no adapter", "failed device creation not reported");
+	CHECK(deviceOf(sessionB) == nullptr && third->refs == 1, "failed device creation: %d references", third->refs);
+
+	gpu.failCreate = false;
+	CHECK(sessionB.initialize() == "" && gpu.devices.size() == 4, "device not created after a failure");
+
+	sessionA.cleanUp();
+	sessionB.cleanUp();
+	CHECK(third->refs == 0 && gpu.devices[3]->refs == 1, "clean up: %d and %d references", third->refs, gpu.devices[3]->refs);
+	CHECK(backendA.duplicatedOn == nullptr && backendB.duplicatedOn == nullptr, "clean up: duplication not released");
+
+	return testResult("devicecache");
+}
@@ -0,0 +1,202 @@
+#include "test.h"
+#include "pixelconvert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Double precision reference for the conversions to RGBA8. The kernels use lookup tables and single precision math,
+// so they may differ from it by one 8 bit step.
+
+static int encodeSrgb(double v) {
+	if (!(v > 0)) v = 0;
+	if (v > 1) v = 1;
+	double s = (v <= 0.0031308) ? v * 12.92 : 1.055 * std::pow(v, 1 / 2.4) - 0.055;
+	return (int)std::lround(s * 255);
+}
+
+static void toneMap(double* c, double sdrWhite, double maxLuminance) {
+	double white = std::max(maxLuminance / sdrWhite, 1.0);
+
+	for (int i = 0; i < 3; i++) {
+		c[i] = (c[i] > 0) ? std::min(c[i], white) : 0;
+	}
+
+	double m = std::max(std::max(c[0], c[1]), c[2]);
+	if (m <= 1) return;
+
+	double t = (white > 1.01) ? std::min((m - 1) / (white - 1), 1.0) : 0;
+
+	for (int i = 0; i < 3; i++) {
+		c[i] = c[i] / m + (1 - c[i] / m) * t;
+	}
+}
+
+static double halfToDouble(uint16_t h) {
+	int exponent = (h >> 10) & 31;
+	int mantissa = h & 1023;
+	double v;
+
+	if (exponent == 0) {
+		v = std::ldexp(mantissa, -24);
+	} else if (exponent == 31) {
+		v = mantissa ? NAN : INFINITY;
+	} else {
+		v = std::ldexp(mantissa + 1024, exponent - 25);
+	}
+
+	return (h & 0x8000) ? -v : v;
+}
+
+// SMPTE ST 2084 EOTF, returns nits
+static double pqToNits(int code) {
+	const double m1 = 2610.0 / 16384, m2 = 2523.0 / 4096 * 128;
+	const double c1 = 3424.0 / 4096, c2 = 2413.0 / 4096 * 32, c3 = 2392.0 / 4096 * 32;
+
+	double e = std::pow(code / 1023.0, 1 / m2);
+	return std::pow(std::max(e - c1, 0.0) / (c2 - c3 * e), 1 / m1) * 10000;
+}
+
+static const double BT2020_TO_BT709[9] = {
+	 1.660491, -0.587641, -0.072850,
+	-0.124550,  1.132900, -0.008349,
+	-0.018151, -0.100579,  1.118730
+};
+
+static int maxError(const uint8_t* a, const int* b, size_t n) {
+	int err = 0;
+	for (size_t i = 0; i < n; i++) {
+		err = std::max(err, std::abs(a[i] - b[i]));
+	}
+	return err;
+}
+
+static void checkHalf(float sdrWhite, float maxLuminance, std::mt19937& rng) {
+	// every half as gray, plus random colors around SDR white
+	const uint32_t count = 65536 * 2;
+	std::vector<uint16_t> src(count * 4);
+
+	for (uint32_t i = 0; i < count; i++) {
+		for (int c = 0; c < 3; c++) {
+			src[i * 4 + c] = (i < 65536) ? (uint16_t)i : (uint16_t)(rng() % 0x4c00); // up to 16.0
+		}
+		src[i * 4 + 3] = (uint16_t)rng();
+	}
+
+	std::vector<uint8_t> dst(count * 4);
+	CONVERSION_PARAMS params = { PIXEL_FORMAT_RGBA16F, COLOR_SPACE_SCRGB, ROTATION_NONE, sdrWhite, maxLuminance };
+	convertToRGBA8(reinterpret_cast<uint8_t*>(src.data()), count * 8, dst.data(), count * 4, count, 1, params);
+
+	for (uint32_t i = 0; i < count; i++) {
+		double c[3];
+		for (int k = 0; k < 3; k++) {
+			double v = halfToDouble(src[i * 4 + k]);
+			c[k] = std::isnan(v) ? 0 : v * 80.0 / sdrWhite;
+		}
+		toneMap(c, sdrWhite, maxLuminance);
+
+		double alpha = halfToDouble(src[i * 4 + 3]);
+		int ref[4] = { encodeSrgb(c[0]), encodeSrgb(c[1]), encodeSrgb(c[2]), std::isnan(alpha) ? 0 : (int)std::lround(std::min(std::max(alpha, 0.0), 1.0) * 255) };
+
+		CHECK(maxError(&dst[i * 4], ref, 4) <= 1, "rgba16f sdrWhite %g: %04x %04x %04x %04x gives %d %d %d %d, expected %d %d %d %d", sdrWhite,
+			src[i * 4], src[i * 4 + 1], src[i * 4 + 2], src[i * 4 + 3], dst[i * 4], dst[i * 4 + 1], dst[i * 4 + 2], dst[i * 4 + 3], ref[0], ref[1], ref[2], ref[3]);
+	}
+}
+
+static void checkRGB10A2(COLOR_SPACE colorSpace, float sdrWhite, std::mt19937& rng) {
+	const uint32_t width = 1921, height = 7;
+	std::vector<uint32_t> src(width * height);
+	for (auto& v : src) v = (uint32_t)rng();
+
+	std::vector<uint8_t> dst(width * height * 4);
+	CONVERSION_PARAMS params = { PIXEL_FORMAT_RGB10A2, colorSpace, ROTATION_NONE, sdrWhite, 1000.0f };
+	convertToRGBA8(reinterpret_cast<uint8_t*>(src.data()), width * 4, dst.data(), width * 4, width, height, params);
+
+	for (uint32_t i = 0; i < width * height; i++) {
+		uint32_t v = src[i];
+		int code[3] = { (int)(v & 1023), (int)((v >> 10) & 1023), (int)((v >> 20) & 1023) };
+		int ref[4];
+
+		if (colorSpace == COLOR_SPACE_PQ) {
+			double c2020[3], c[3];
+			for (int k = 0; k < 3; k++) c2020[k] = pqToNits(code[k]) / sdrWhite;
+			for (int k = 0; k < 3; k++) c[k] = c2020[0] * BT2020_TO_BT709[k * 3] + c2020[1] * BT2020_TO_BT709[k * 3 + 1] + c2020[2] * BT2020_TO_BT709[k * 3 + 2];
+
+			toneMap(c, sdrWhite, 1000.0);
+			for (int k = 0; k < 3; k++) ref[k] = encodeSrgb(c[k]);
+		} else {
+			for (int k = 0; k < 3; k++) ref[k] = (int)std::lround(code[k] * 255.0 / 1023.0);
+		}
+		ref[3] = (int)(v >> 30) * 85;
+
+		CHECK(maxError(&dst[i * 4], ref, 4) <= 1, "rgb10a2 %s: %08x gives %d %d %d %d, expected %d %d %d %d", colorSpaceName(colorSpace), v,
+			dst[i * 4], dst[i * 4 + 1], dst[i * 4 + 2], dst[i * 4 + 3], ref[0], ref[1], ref[2], ref[3]);
+	}
+}
+
+static void checkBGRA8(std::mt19937& rng) {
+	const uint32_t width = 67, height = 3;
+	std::vector<uint8_t> src(width * height * 4);
+	for (auto& v : src) v = (uint8_t)rng();
+
+	std::vector<uint8_t> dst(src.size());
+	CONVERSION_PARAMS params = { PIXEL_FORMAT_BGRA8, COLOR_SPACE_SRGB, ROTATION_NONE, 80.0f, 1000.0f };
+	convertToRGBA8(src.data(), width * 4, dst.data(), width * 4, width, height, params);
+
+	for (uint32_t i = 0; i < width * height; i++) {
+		CHECK(dst[i * 4] == src[i * 4 + 2] && dst[i * 4 + 1] == src[i * 4 + 1] && dst[i * 4 + 2] == src[i * 4] && dst[i * 4 + 3] == src[i * 4 + 3], "bgra8: pixel %u not swizzled", i);
+	}
+}
+
+// converts a single gray fp16 pixel
+static uint8_t convertHalfGray(float value, float sdrWhite) {
+	uint16_t h = 0;
+	for (uint32_t i = 0; i < 0x7c00; i++) {
+		if (halfToDouble((uint16_t)i) <= value) h = (uint16_t)i;
+	}
+
+	uint16_t src[4] = { h, h, h, 0x3c00 };
+	uint8_t dst[4];
+	CONVERSION_PARAMS params = { PIXEL_FORMAT_RGBA16F, COLOR_SPACE_SCRGB, ROTATION_NONE, sdrWhite, 1000.0f };
+	convertToRGBA8(reinterpret_cast<uint8_t*>(src), 8, dst, 4, 1, 1, params);
+
+	return dst[0];
+}
+
+static void checkSdrWhite() {
+	// scRGB encodes SDR white as sdrWhiteLevel / 80
+	CHECK(convertHalfGray(1.0f, 80.0f) == 255, "scRGB 1.0 with SDR white at 80 nits is not full white");
+	CHECK(convertHalfGray(2.5f, 200.0f) == 255, "scRGB 2.5 with SDR white at 200 nits is not full white");
+	CHECK(convertHalfGray(0.5f, 80.0f) == encodeSrgb(0.5), "scRGB below SDR white is changed by the tone mapping");
+
+	// PQ code for 203 nits (the reference white of BT.2408)
+	int code = 0;
+	for (int i = 0; i < 1024; i++) {
+		if (pqToNits(i) <= 203) code = i;
+	}
+
+	uint32_t src = (uint32_t)code | ((uint32_t)code << 10) | ((uint32_t)code << 20) | (3u << 30);
+	uint8_t dst[4];
+	CONVERSION_PARAMS params = { PIXEL_FORMAT_RGB10A2, COLOR_SPACE_PQ, ROTATION_NONE, (float)pqToNits(code), 1000.0f };
+	convertToRGBA8(reinterpret_cast<uint8_t*>(&src), 4, dst, 4, 1, 1, params);
+
+	CHECK(dst[0] >= 254 && dst[1] >= 254 && dst[2] >= 254, "PQ SDR white gives %d %d %d", dst[0], dst[1], dst[2]);
+}
+
+int main() {
+	std::mt19937 rng(2);
+
+	checkHalf(80.0f, 1000.0f, rng);
+	checkHalf(200.0f, 1000.0f, rng);
+	checkHalf(80.0f, 80.0f, rng); // no headroom, clipping only
+	checkRGB10A2(COLOR_SPACE_SRGB, 80.0f, rng);
+	checkRGB10A2(COLOR_SPACE_PQ, 80.0f, rng);
+	checkRGB10A2(COLOR_SPACE_PQ, 203.0f, rng);
+	checkBGRA8(rng);
+	checkSdrWhite();
+
+	return testResult("pixelconvert_test");
+}
@@ -0,0 +1,98 @@
+#include "test.h"
+#include "pixelconvert.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+// every orientation is checked against the unrotated conversion, pixel by pixel
+static void checkRotation(PIXEL_FORMAT format, COLOR_SPACE colorSpace, uint32_t width, uint32_t height, std::mt19937& rng) {
+	uint32_t bpp = bytesPerPixel(format);
+	size_t srcPitch = (size_t)width * bpp + 12; // padded like a mapped texture
+	std::vector<uint8_t> src(srcPitch * height);
+
+	for (auto& v : src) {
+		// keep halfs in a sane range, the tone mapping has its own test
+		v = (uint8_t)(rng() & ((format == PIXEL_FORMAT_RGBA16F) ? 0x3b : 0xff));
+	}
+
+	CONVERSION_PARAMS params = { format, colorSpace, ROTATION_NONE, 80.0f, 1000.0f };
+
+	std::vector<uint8_t> upright((size_t)width * height * 4);
+	convertToRGBA8(src.data(), srcPitch, upright.data(), (size_t)width * 4, width, height, params);
+
+	for (int r = ROTATION_NONE; r <= ROTATION_270; r++) {
+		ROTATION rotation = (ROTATION)r;
+		bool swapDimensions = (rotation == ROTATION_90 || rotation == ROTATION_270);
+		uint32_t dstWidth = swapDimensions ? height : width;
+		uint32_t dstHeight = swapDimensions ? width : height;
+
+		size_t dstPitch = (size_t)dstWidth * 4 + 8;
+		std::vector<uint8_t> converted(dstPitch * dstHeight, 0xcd);
+		params.rotation = rotation;
+		convertToRGBA8(src.data(), srcPitch, converted.data(), dstPitch, width, height, params);
+
+		size_t copyPitch = (size_t)dstWidth * bpp + 8;
+		std::vector<uint8_t> copied(copyPitch * dstHeight, 0xcd);
+		copyRotated(src.data(), srcPitch, copied.data(), copyPitch, width, height, bpp, rotation);
+
+		for (uint32_t y = 0; y < height; y++) {
+			for (uint32_t x = 0; x < width; x++) {
+				uint32_t dx, dy;
+
+				switch (rotation) {
+					case ROTATION_90:
+						dx = height - 1 - y;
+						dy = x;
+						break;
+					case ROTATION_180:
+						dx = width - 1 - x;
+						dy = height - 1 - y;
+						break;
+					case ROTATION_270:
+						dx = y;
+						dy = width - 1 - x;
+						break;
+					default:
+						dx = x;
+						dy = y;
+						break;
+				}
+
+				CHECK(std::memcmp(&converted[dy * dstPitch + dx * 4], &upright[((size_t)y * width + x) * 4], 4) == 0,
+					"convertToRGBA8 %s %dx%d rotation %d: wrong pixel at %u,%u", pixelFormatName(format), width, height, r * 90, x, y);
+
+				CHECK(std::memcmp(&copied[dy * copyPitch + dx * bpp], &src[y * srcPitch + x * bpp], bpp) == 0,
+					"copyRotated %s %dx%d rotation %d: wrong pixel at %u,%u", pixelFormatName(format), width, height, r * 90, x, y);
+			}
+		}
+
+		for (uint32_t y = 0; y < dstHeight; y++) {
+			for (size_t i = (size_t)dstWidth * 4; i < dstPitch; i++) {
+				CHECK(converted[y * dstPitch + i] == 0xcd, "convertToRGBA8 %s %dx%d rotation %d: row padding overwritten", pixelFormatName(format), width, height, r * 90);
+			}
+			for (size_t i = (size_t)dstWidth * bpp; i < copyPitch; i++) {
+				CHECK(copied[y * copyPitch + i] == 0xcd, "copyRotated %s %dx%d rotation %d: row padding overwritten", pixelFormatName(format), width, height, r * 90);
+			}
+		}
+	}
+}
+
+int main() {
+	std::mt19937 rng(1);
+
+	// odd sizes and sizes around the SIMD widths and the rotation tile size
+	const uint32_t sizes[] = { 1, 2, 3, 4, 5, 7, 31, 32, 33, 63, 65, 97 };
+
+	for (uint32_t width : sizes) {
+		for (uint32_t height : sizes) {
+			checkRotation(PIXEL_FORMAT_BGRA8, COLOR_SPACE_SRGB, width, height, rng);
+			checkRotation(PIXEL_FORMAT_RGBA8, COLOR_SPACE_SRGB, width, height, rng);
+			checkRotation(PIXEL_FORMAT_RGB10A2, COLOR_SPACE_SRGB, width, height, rng);
+			checkRotation(PIXEL_FORMAT_RGB10A2, COLOR_SPACE_PQ, width, height, rng);
+			checkRotation(PIXEL_FORMAT_RGBA16F, COLOR_SPACE_SCRGB, width, height, rng);
+		}
+	}
+
+	return testResult("rotation_test");
+}
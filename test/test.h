@@ -0,0 +1,36 @@
+#pragma once
+
+// Minimal checks for the native test programs. They only cover the parts of the addon which don't depend on Windows.
+
+#include <cstdio>
+
+static int g_failures = 0;
+
+// prints the first few failures only, a broken kernel would otherwise print one line per pixel
+#define CHECK(cond, ...) \
+	do { \
+		if (!(cond)) { \
+			if (g_failures++ < 20) { \
+				std::printf("%s:%d: ", __FILE__, __LINE__); \
+				std::printf(__VA_ARGS__); \
+				std::printf("\n"); \
+			} \
+		} \
+	} while (0)
+
+// the Makefile builds the kernel tests a second time without SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEST_VARIANT ""
+#else
+#define TEST_VARIANT " (scalar)"
+#endif
+
+static int testResult(const char* name) {
+	if (g_failures > 0) {
+		std::printf("%s%s: %d failures\n", name, TEST_VARIANT, g_failures);
+		return 1;
+	}
+
+	std::printf("%s%s: ok\n", name, TEST_VARIANT);
+	return 0;
+}
@@ -0,0 +1,188 @@
+#include "test.h"
+#include "pixelconvert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Double precision reference for the 4:2:0 conversion, working on the RGBA8 image which convertToRGBA8 produces.
+// Chroma is computed from the average of each 2x2 block, repeating the last row and column for odd sizes.
+
+static int clampByte(double v) {
+	long r = std::lround(v);
+	return (int)((r < 0) ? 0 : (r > 255) ? 255 : r);
+}
+
+static void referenceYUV(const uint8_t* rgba, uint32_t width, uint32_t height, const YUV_PARAMS& yuv, std::vector<int>& y, std::vector<int>& u, std::vector<int>& v) {
+	double kr = (yuv.matrix == YUV_MATRIX_BT601) ? 0.299 : 0.2126;
+	double kb = (yuv.matrix == YUV_MATRIX_BT601) ? 0.114 : 0.0722;
+	double kg = 1 - kr - kb;
+	double yScale = yuv.fullRange ? 1 : 219 / 255.0;
+	double uvScale = yuv.fullRange ? 1 : 224 / 255.0;
+	double yOffset = yuv.fullRange ? 0 : 16;
+
+	uint32_t chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+	y.resize((size_t)width * height);
+	u.resize((size_t)chromaWidth * chromaHeight);
+	v.resize((size_t)chromaWidth * chromaHeight);
+
+	for (size_t i = 0; i < (size_t)width * height; i++) {
+		y[i] = clampByte(yOffset + yScale * (kr * rgba[i * 4] + kg * rgba[i * 4 + 1] + kb * rgba[i * 4 + 2]));
+	}
+
+	for (uint32_t cy = 0; cy < chromaHeight; cy++) {
+		for (uint32_t cx = 0; cx < chromaWidth; cx++) {
+			double r = 0, g = 0, b = 0;
+
+			for (uint32_t dy = 0; dy < 2; dy++) {
+				for (uint32_t dx = 0; dx < 2; dx++) {
+					uint32_t px = std::min(cx * 2 + dx, width - 1);
+					uint32_t py = std::min(cy * 2 + dy, height - 1);
+					const uint8_t* p = rgba + ((size_t)py * width + px) * 4;
+
+					r += p[0] / 4.0;
+					g += p[1] / 4.0;
+					b += p[2] / 4.0;
+				}
+			}
+
+			double luma = kr * r + kg * g + kb * b;
+			u[cy * chromaWidth + cx] = clampByte(128 + uvScale * (b - luma) / (2 * (1 - kb)));
+			v[cy * chromaWidth + cx] = clampByte(128 + uvScale * (r - luma) / (2 * (1 - kr)));
+		}
+	}
+}
+
+static void checkYUV(PIXEL_FORMAT format, ROTATION rotation, uint32_t width, uint32_t height, const YUV_PARAMS& yuv, std::mt19937& rng) {
+	uint32_t bpp = bytesPerPixel(format);
+	size_t srcPitch = (size_t)width * bpp + 12;
+	std::vector<uint8_t> src(srcPitch * height);
+
+	// random noise, or only black and white to hit the ends of the range
+	bool extremes = (rng() % 3 == 0);
+	for (auto& s : src) {
+		s = (uint8_t)rng();
+		if (extremes) s = (s & 1) ? 0xff : 0;
+	}
+
+	CONVERSION_PARAMS params = { format, COLOR_SPACE_SRGB, rotation, 80.0f, 1000.0f };
+
+	bool swapDimensions = (rotation == ROTATION_90 || rotation == ROTATION_270);
+	uint32_t dstWidth = swapDimensions ? height : width;
+	uint32_t dstHeight = swapDimensions ? width : height;
+
+	std::vector<uint8_t> rgba((size_t)dstWidth * dstHeight * 4);
+	convertToRGBA8(src.data(), srcPitch, rgba.data(), (size_t)dstWidth * 4, width, height, params);
+
+	PLANE_LAYOUT planes[3];
+	uint32_t planeCount;
+	size_t size = yuvPlaneLayout(yuv.layout, dstWidth, dstHeight, planes, &planeCount);
+
+	CHECK(planeCount == ((yuv.layout == YUV_LAYOUT_NV12) ? 2u : 3u), "wrong plane count %u", planeCount);
+	CHECK(size == (size_t)dstWidth * dstHeight + 2 * (size_t)((dstWidth + 1) / 2) * ((dstHeight + 1) / 2), "wrong size %zu for %ux%u", size, dstWidth, dstHeight);
+
+	// guard bytes behind the image catch writes past the end
+	std::vector<uint8_t> dst(size + 64, 0xcd);
+	convertToYUV420(src.data(), srcPitch, dst.data(), planes, width, height, params, yuv);
+
+	for (size_t i = size; i < dst.size(); i++) {
+		CHECK(dst[i] == 0xcd, "%ux%u: write past the end of the image", width, height);
+	}
+
+	std::vector<int> y, u, v;
+	referenceYUV(rgba.data(), dstWidth, dstHeight, yuv, y, u, v);
+
+	const char* name = (yuv.layout == YUV_LAYOUT_NV12) ? "nv12" : "i420";
+	const char* matrix = (yuv.matrix == YUV_MATRIX_BT601) ? "bt601" : "bt709";
+	const char* range = yuv.fullRange ? "full" : "limited";
+
+	for (uint32_t py = 0; py < dstHeight; py++) {
+		for (uint32_t px = 0; px < dstWidth; px++) {
+			int got = dst[planes[0].offset + py * planes[0].pitch + px];
+			int expected = y[(size_t)py * dstWidth + px];
+
+			CHECK(std::abs(got - expected) <= 1, "%s %s %s %s %ux%u rotation %d: Y at %u,%u is %d, expected %d",
+				name, matrix, range, pixelFormatName(format), width, height, rotation * 90, px, py, got, expected);
+		}
+	}
+
+	uint32_t chromaWidth = (dstWidth + 1) / 2;
+	for (uint32_t cy = 0; cy < planes[1].height; cy++) {
+		for (uint32_t cx = 0; cx < chromaWidth; cx++) {
+			int gotU, gotV;
+
+			if (yuv.layout == YUV_LAYOUT_NV12) {
+				gotU = dst[planes[1].offset + cy * planes[1].pitch + cx * 2];
+				gotV = dst[planes[1].offset + cy * planes[1].pitch + cx * 2 + 1];
+			} else {
+				gotU = dst[planes[1].offset + cy * planes[1].pitch + cx];
+				gotV = dst[planes[2].offset + cy * planes[2].pitch + cx];
+			}
+
+			int expectedU = u[cy * chromaWidth + cx];
+			int expectedV = v[cy * chromaWidth + cx];
+
+			CHECK(std::abs(gotU - expectedU) <= 1 && std::abs(gotV - expectedV) <= 1, "%s %s %s %s %ux%u rotation %d: UV at %u,%u is %d,%d, expected %d,%d",
+				name, matrix, range, pixelFormatName(format), width, height, rotation * 90, cx, cy, gotU, gotV, expectedU, expectedV);
+		}
+	}
+}
+
+// black, white and gray have to hit the ends and the middle of the range exactly
+static void checkGray(YUV_MATRIX matrix, bool fullRange) {
+	const int levels[] = { 0, 128, 255 };
+
+	for (int level : levels) {
+		uint8_t src[4 * 4];
+		for (int i = 0; i < 16; i++) {
+			src[i] = (uint8_t)((i % 4 == 3) ? 255 : level);
+		}
+
+		PLANE_LAYOUT planes[3];
+		uint32_t planeCount;
+		uint8_t dst[6];
+		YUV_PARAMS yuv = { YUV_LAYOUT_NV12, matrix, fullRange };
+		yuvPlaneLayout(yuv.layout, 2, 2, planes, &planeCount);
+
+		CONVERSION_PARAMS params = { PIXEL_FORMAT_BGRA8, COLOR_SPACE_SRGB, ROTATION_NONE, 80.0f, 1000.0f };
+		convertToYUV420(src, 8, dst, planes, 2, 2, params, yuv);
+
+		int expectedY = fullRange ? level : (int)std::lround(16 + level * 219 / 255.0);
+
+		CHECK(dst[0] == expectedY && dst[4] == 128 && dst[5] == 128, "gray %d (%s, %s range) gives Y %d U %d V %d",
+			level, (matrix == YUV_MATRIX_BT601) ? "bt601" : "bt709", fullRange ? "full" : "limited", dst[0], dst[4], dst[5]);
+	}
+}
+
+int main() {
+	std::mt19937 rng(3);
+
+	// odd sizes, sizes around the 16 pixel SIMD width and rotated images spanning several strips
+	const uint32_t sizes[][2] = { { 1, 1 }, { 2, 2 }, { 3, 5 }, { 15, 3 }, { 16, 2 }, { 17, 9 }, { 33, 7 }, { 64, 64 }, { 97, 31 }, { 5, 67 }, { 1921, 5 } };
+	const PIXEL_FORMAT formats[] = { PIXEL_FORMAT_BGRA8, PIXEL_FORMAT_RGBA8, PIXEL_FORMAT_RGB10A2 };
+
+	for (auto& size : sizes) {
+		for (int layout = YUV_LAYOUT_NV12; layout <= YUV_LAYOUT_I420; layout++) {
+			for (int matrix = YUV_MATRIX_BT601; matrix <= YUV_MATRIX_BT709; matrix++) {
+				for (int fullRange = 0; fullRange <= 1; fullRange++) {
+					YUV_PARAMS yuv = { (YUV_LAYOUT)layout, (YUV_MATRIX)matrix, fullRange != 0 };
+
+					for (PIXEL_FORMAT format : formats) {
+						for (int rotation = ROTATION_NONE; rotation <= ROTATION_270; rotation++) {
+							checkYUV(format, (ROTATION)rotation, size[0], size[1], yuv, rng);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for (int matrix = YUV_MATRIX_BT601; matrix <= YUV_MATRIX_BT709; matrix++) {
+		checkGray((YUV_MATRIX)matrix, false);
+		checkGray((YUV_MATRIX)matrix, true);
+	}
+
+	return testResult("yuv_test");
+}